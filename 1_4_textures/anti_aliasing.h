@@ -0,0 +1,216 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "post_process.h"
+#include "render_target_pool.h"
+#include "shader_compile_queue.h"
+#include "shader_preprocessor.h"
+#include "shader_s.h"
+
+#include <string>
+
+// How the scene is anti-aliased.
+//  Off   one sample per pixel
+//  Msaa  a multisampled scene target, resolved by a blit (straight into the default framebuffer
+//        when nothing else has to read the image)
+//  Fxaa  one sample per pixel, edges smoothed by fxaaEffect() at the head of the post chain
+//  Taa   one sample per pixel at a different sub-pixel offset every frame, accumulated over
+//        frames by TemporalAA
+enum class AntiAliasingMode {
+    Off,
+    Msaa,
+    Fxaa,
+    Taa,
+};
+
+inline const char* antiAliasingModeName(AntiAliasingMode mode) {
+    switch (mode) {
+    case AntiAliasingMode::Msaa: return "msaa";
+    case AntiAliasingMode::Fxaa: return "fxaa";
+    case AntiAliasingMode::Taa: return "taa";
+    default: return "off";
+    }
+}
+
+// "off", "msaa", "fxaa" or "taa"; false for anything else
+inline bool parseAntiAliasingMode(const std::string& name, AntiAliasingMode& mode) {
+    if (name == "off")
+        mode = AntiAliasingMode::Off;
+    else if (name == "msaa")
+        mode = AntiAliasingMode::Msaa;
+    else if (name == "fxaa")
+        mode = AntiAliasingMode::Fxaa;
+    else if (name == "taa")
+        mode = AntiAliasingMode::Taa;
+    else
+        return false;
+    return true;
+}
+
+// FXAA (after Lottes' FXAA 3.11, quality preset with 10 search steps) as a neighborhood effect of
+// a PostProcessChain, so the per-pixel effects after it share its pass. Pixels whose luma
+// contrast with the four neighbours is below the thresholds are returned as they are; on an edge
+// the pixel is re-sampled bilinearly, shifted across the edge by how far it is from the nearer end
+// of the edge (found by walking along it) and by how much it differs from its 3x3 average.
+// Expects colors in display (gamma) space, which is what the scene renders.
+inline PostEffect fxaaEffect() {
+    PostEffect effect;
+    effect.name = "fxaa";
+    effect.kind = PostEffect::Neighborhood;
+    effect.body =
+        "const vec3 toLuma = vec3(0.299, 0.587, 0.114);\n"
+        "    vec3 center = fetch(uv);\n"
+        "    float lumaM = dot(center, toLuma);\n"
+        "    float lumaN = dot(fetch(uv + vec2(0.0, texelSize.y)), toLuma);\n"
+        "    float lumaS = dot(fetch(uv - vec2(0.0, texelSize.y)), toLuma);\n"
+        "    float lumaE = dot(fetch(uv + vec2(texelSize.x, 0.0)), toLuma);\n"
+        "    float lumaW = dot(fetch(uv - vec2(texelSize.x, 0.0)), toLuma);\n"
+        "    float lumaMin = min(lumaM, min(min(lumaN, lumaS), min(lumaE, lumaW)));\n"
+        "    float lumaMax = max(lumaM, max(max(lumaN, lumaS), max(lumaE, lumaW)));\n"
+        "    float range = lumaMax - lumaMin;\n"
+        "    if (range < max(0.0312, lumaMax * 0.125))\n"
+        "        return center;\n"
+        "    float lumaNE = dot(fetch(uv + texelSize), toLuma);\n"
+        "    float lumaSW = dot(fetch(uv - texelSize), toLuma);\n"
+        "    float lumaNW = dot(fetch(uv + vec2(-texelSize.x, texelSize.y)), toLuma);\n"
+        "    float lumaSE = dot(fetch(uv + vec2(texelSize.x, -texelSize.y)), toLuma);\n"
+        "\n"
+        "    // sub-pixel aliasing: how far the pixel is from the average of its neighbourhood\n"
+        "    float average = (2.0 * (lumaN + lumaS + lumaE + lumaW) + lumaNE + lumaSW + lumaNW + lumaSE) / 12.0;\n"
+        "    float subpixel = smoothstep(0.0, 1.0, clamp(abs(average - lumaM) / range, 0.0, 1.0));\n"
+        "    subpixel = subpixel * subpixel * 0.75;\n"
+        "\n"
+        "    // edge orientation, and the side of the pixel it runs on\n"
+        "    float horizontal = 2.0 * abs(lumaN + lumaS - 2.0 * lumaM) + abs(lumaNE + lumaSE - 2.0 * lumaE) + abs(lumaNW + lumaSW - 2.0 * lumaW);\n"
+        "    float vertical = 2.0 * abs(lumaE + lumaW - 2.0 * lumaM) + abs(lumaNE + lumaNW - 2.0 * lumaN) + abs(lumaSE + lumaSW - 2.0 * lumaS);\n"
+        "    bool isHorizontal = horizontal >= vertical;\n"
+        "    float lumaPositive = isHorizontal ? lumaN : lumaE;\n"
+        "    float lumaNegative = isHorizontal ? lumaS : lumaW;\n"
+        "    float stepLength = isHorizontal ? texelSize.y : texelSize.x;\n"
+        "    float lumaOpposite = lumaPositive;\n"
+        "    float gradient = abs(lumaPositive - lumaM);\n"
+        "    if (abs(lumaNegative - lumaM) > gradient) {\n"
+        "        stepLength = -stepLength;\n"
+        "        lumaOpposite = lumaNegative;\n"
+        "        gradient = abs(lumaNegative - lumaM);\n"
+        "    }\n"
+        "\n"
+        "    // walk along the edge both ways until the luma differs from the edge's by a quarter of the gradient\n"
+        "    const float steps[10] = float[](1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);\n"
+        "    vec2 edgeUv = uv + (isHorizontal ? vec2(0.0, 0.5 * stepLength) : vec2(0.5 * stepLength, 0.0));\n"
+        "    vec2 edgeStep = isHorizontal ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);\n"
+        "    float edgeLuma = 0.5 * (lumaM + lumaOpposite);\n"
+        "    float gradientThreshold = 0.25 * gradient;\n"
+        "    vec2 uvPositive = edgeUv + edgeStep, uvNegative = edgeUv - edgeStep;\n"
+        "    float deltaPositive = dot(fetch(uvPositive), toLuma) - edgeLuma;\n"
+        "    float deltaNegative = dot(fetch(uvNegative), toLuma) - edgeLuma;\n"
+        "    for (int i = 1; i < 10 && abs(deltaPositive) < gradientThreshold; i++) {\n"
+        "        uvPositive += edgeStep * steps[i];\n"
+        "        deltaPositive = dot(fetch(uvPositive), toLuma) - edgeLuma;\n"
+        "    }\n"
+        "    for (int i = 1; i < 10 && abs(deltaNegative) < gradientThreshold; i++) {\n"
+        "        uvNegative -= edgeStep * steps[i];\n"
+        "        deltaNegative = dot(fetch(uvNegative), toLuma) - edgeLuma;\n"
+        "    }\n"
+        "    float distancePositive = isHorizontal ? uvPositive.x - uv.x : uvPositive.y - uv.y;\n"
+        "    float distanceNegative = isHorizontal ? uv.x - uvNegative.x : uv.y - uvNegative.y;\n"
+        "    float shortest = min(distancePositive, distanceNegative);\n"
+        "    float deltaEnd = distancePositive <= distanceNegative ? deltaPositive : deltaNegative;\n"
+        "    // only blend if the pixel is on the side of the edge that the nearer end bends towards\n"
+        "    float edgeBlend = (deltaEnd < 0.0) != (lumaM - edgeLuma < 0.0) ? 0.5 - shortest / (distancePositive + distanceNegative) : 0.0;\n"
+        "\n"
+        "    float offset = max(subpixel, edgeBlend) * stepLength;\n"
+        "    return fetch(uv + (isHorizontal ? vec2(0.0, offset) : vec2(offset, 0.0)));";
+    return effect;
+}
+
+// Temporal anti-aliasing. The scene is rendered with the camera's jitteredProjection, moved by a
+// different sub-pixel offset every frame (the Halton(2, 3) sequence, JitterSamples long), so over a
+// few frames every pixel sees several positions inside it. resolve() blends the new frame into the
+// history: every pixel finds where it was in the previous frame from its depth, this frame's
+// jitter and the two (unjittered) view-projection matrices, takes the history color there, clamps it to the color
+// range of its 3x3 neighbourhood in the new frame (which hides most ghosting from disocclusions
+// and moving rocks, whose own motion is not reprojected) and keeps (1 - blend) of it.
+//
+// The history is a render target of the pool that stays acquired from one resolve() to the next;
+// when the scene size changes it no longer fits and the next frame starts over from the new frame.
+//
+//     camera.SetJitter(taa.jitter(frame, sceneWidth, sceneHeight));
+//     ... render the scene (color + sampledDepth) with snapshot->jitteredProjection ...
+//     RenderTarget* image = taa.resolve(*scene, *snapshot, pool, historyDesc, quadVAO);   // don't release it
+class TemporalAA {
+public:
+    static const unsigned int JitterSamples = 8;
+
+    TemporalAA(ShaderCompileQueue& queue, const char* quadVertexPath, float blend = 0.1f) : blend(blend) {
+        ShaderSources sources;
+        sources.vertex = ShaderPreprocessor::process(quadVertexPath);
+        sources.fragment = ShaderPreprocessor::process("./shaders/taaResolveShader.fs");
+        shader = &queue.add(sources);
+    }
+
+    // offset of this frame's projection in NDC, for a scene target of width x height pixels
+    static glm::vec2 jitter(unsigned long long frame, int width, int height) {
+        unsigned int index = (unsigned int)(frame % JitterSamples) + 1; // Halton index 0 is (0, 0)
+        return glm::vec2((halton(index, 2) - 0.5f) * 2.0f / width, (halton(index, 3) - 0.5f) * 2.0f / height);
+    }
+
+    // blend 'scene' (a GL_TEXTURE_2D color and sampled depth) into the history and return the
+    // result, the size of 'scene'; it stays valid until the next resolve() or reset()
+    RenderTarget* resolve(const RenderTarget& scene, const CameraSnapshot& camera, RenderTargetPool& pool, const RenderTargetDesc& historyDesc, GLuint quadVAO) {
+        RenderTarget* output = pool.acquire(historyDesc);
+        bool valid = history && history->width == output->width && history->height == output->height;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, output->fbo);
+        glViewport(0, 0, output->width, output->height);
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(quadVAO);
+        shader->use();
+        shader->setInt("currentTexture", 0);
+        shader->setInt("depthTexture", 1);
+        shader->setInt("historyTexture", 2);
+        shader->setMatrix4("reprojection", previousViewProjection * camera.inverseViewProjection);
+        shader->setVec2("jitter", camera.jitter);
+        shader->setVec2("texelSize", 1.0f / scene.width, 1.0f / scene.height);
+        shader->setFloat("blend", valid ? blend : 1.0f);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, scene.color);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, scene.depth);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, valid ? history->color : scene.color);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glActiveTexture(GL_TEXTURE0);
+
+        if (history)
+            pool.release(history);
+        history = output;
+        previousViewProjection = camera.viewProjection;
+        return output;
+    }
+
+    // forget the history, e.g. when switching to another mode
+    void reset(RenderTargetPool& pool) {
+        if (history)
+            pool.release(history);
+        history = nullptr;
+    }
+
+private:
+    Shader* shader = nullptr;
+    float blend;
+    RenderTarget* history = nullptr;
+    glm::mat4 previousViewProjection = glm::mat4(1.0f);
+
+    static float halton(unsigned int index, unsigned int base) {
+        float result = 0.0f, fraction = 1.0f;
+        while (index > 0) {
+            fraction /= base;
+            result += fraction * (index % base);
+            index /= base;
+        }
+        return result;
+    }
+};
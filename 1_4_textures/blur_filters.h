@@ -0,0 +1,277 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "post_process.h"
+#include "render_target_pool.h"
+#include "shader_compile_queue.h"
+#include "shader_preprocessor.h"
+#include "shader_s.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+// Wide blurs for the post-processing chain. Both filters read a texture of any size (the scene,
+// when they head the chain and the render scale is below 1) and draw into a screen sized FBO with
+// the full-screen quad that is bound when they are called, and take their intermediate targets
+// from the RenderTargetPool. The strength is a Gaussian sigma in pixels at
+// 1080 lines and is scaled with the actual height, so the image looks the same at any resolution;
+// every offset is computed from the size of the texture actually read.
+
+// Separable Gaussian: a horizontal and a vertical pass with linear sampling, i.e. two neighbouring
+// texels with weights w1, w2 are read with one bilinear fetch at the offset (o1 w1 + o2 w2) / (w1 + w2)
+// weighted w1 + w2, so a radius of 3 sigma takes 1 + ceil(3 sigma / 2) fetches per side instead of
+// 1 + 3 sigma. Past MaxSigma texels the passes run at half (quarter, ...) resolution with a
+// proportionally smaller sigma, and a bilinear upsample writes the output. The horizontal pass
+// reads a source of up to twice its own size (its bilinear fetches then average pairs of texels);
+// a larger input is first halved, each halving one bilinear fetch at the shared corner of 2x2
+// texels (a box filter), so no input texel is skipped.
+class GaussianBlur {
+public:
+    static const int MaxTaps = 16;   // the shader's MAX_TAPS: a radius of up to 30 texels
+    static constexpr float MaxSigma = 10.0f;
+
+    GaussianBlur(ShaderCompileQueue& queue, const char* quadVertexPath, float sigma = 8.0f) : sigma1080(sigma) {
+        ShaderSources sources;
+        sources.vertex = ShaderPreprocessor::process(quadVertexPath);
+        sources.fragment = ShaderPreprocessor::process("./shaders/gaussianBlurShader.fs");
+        shader = &queue.add(sources);
+    }
+
+    void setSigma(float sigma) {
+        sigma1080 = sigma;
+    }
+
+    float sigma() const {
+        return sigma1080;
+    }
+
+    // taps of one side of a blur with this sigma (in texels), center first; returns their number
+    static int linearTaps(float sigma, float* offsets, float* weights) {
+        int radius = std::min((int)std::ceil(3.0f * sigma), 2 * (MaxTaps - 1));
+        float discrete[2 * MaxTaps];
+        float total = 0.0f;
+        for (int i = 0; i <= radius; i++) {
+            discrete[i] = sigma > 0.0f ? std::exp(-0.5f * i * i / (sigma * sigma)) : (i == 0 ? 1.0f : 0.0f);
+            total += i == 0 ? discrete[i] : 2.0f * discrete[i];
+        }
+        offsets[0] = 0.0f;
+        weights[0] = discrete[0] / total;
+        int taps = 1;
+        for (int i = 1; i <= radius; i += 2) {
+            float w1 = discrete[i], w2 = i + 1 <= radius ? discrete[i + 1] : 0.0f;
+            weights[taps] = (w1 + w2) / total;
+            offsets[taps] = (i * w1 + (i + 1) * w2) / (w1 + w2);
+            taps++;
+        }
+        return taps;
+    }
+
+    void apply(GLuint input, int inputWidth, int inputHeight, GLuint outputFbo, RenderTargetPool& pool, const RenderTargetDesc& intermediate) {
+        float sigma = sigma1080 * pool.height() / 1080.0f;
+        int divisor = 1;
+        while (sigma / divisor > MaxSigma && divisor < 8)
+            divisor *= 2;
+        float offsets[MaxTaps], weights[MaxTaps];
+        int taps = linearTaps(sigma / divisor, offsets, weights);
+
+        shader->use();
+        shader->setInt("screenTexture", 0);
+
+        // halve the input down to at most twice the size of the passes' targets (levels no smaller
+        // than their source, e.g. for an input already at a reduced render scale, are skipped)
+        RenderTargetDesc desc = intermediate;
+        GLuint source = input;
+        int sourceWidth = inputWidth, sourceHeight = inputHeight;
+        RenderTarget* reduced = nullptr;
+        int passes = 0;
+        setSingleTap();
+        for (int level = 2; level < divisor; level *= 2) {
+            desc.divisor = level;
+            int width, height;
+            pool.targetSize(desc, width, height);
+            if (width >= sourceWidth && height >= sourceHeight)
+                continue;
+            RenderTarget* target = pool.acquire(desc);
+            draw(source, target->fbo, target->width, target->height, glm::vec2(0.0f));
+            if (reduced)
+                pool.release(reduced);
+            reduced = target;
+            source = target->color;
+            sourceWidth = target->width;
+            sourceHeight = target->height;
+            passes++;
+        }
+
+        desc.divisor = divisor;
+        RenderTarget* horizontal = pool.acquire(desc);
+        glUniform1fv(shader->location("offsets"), taps, offsets);
+        glUniform1fv(shader->location("weights"), taps, weights);
+        shader->setInt("taps", taps);
+        // one texel of the target along each axis
+        draw(source, horizontal->fbo, horizontal->width, horizontal->height, glm::vec2(1.0f / horizontal->width, 0.0f));
+        if (reduced)
+            pool.release(reduced);
+
+        RenderTarget* vertical = divisor > 1 ? pool.acquire(desc) : nullptr;
+        draw(horizontal->color, vertical ? vertical->fbo : outputFbo, horizontal->width, horizontal->height, glm::vec2(0.0f, 1.0f / horizontal->height));
+        pool.release(horizontal);
+        passes += 2;
+        if (vertical) {
+            setSingleTap();
+            draw(vertical->color, outputFbo, pool.width(), pool.height(), glm::vec2(0.0f));
+            pool.release(vertical);
+            passes++;
+        }
+        lastPasses = passes;
+        lastTaps = taps;
+        lastDivisor = divisor;
+    }
+
+    // this filter as a node of a PostProcessChain
+    PostEffect effect(const std::string& name = "gaussian") {
+        PostEffect node;
+        node.name = name;
+        node.kind = PostEffect::Filter;
+        node.filter = [this](GLuint input, int inputWidth, int inputHeight, GLuint outputFbo, RenderTargetPool& pool, const RenderTargetDesc& intermediate) {
+            apply(input, inputWidth, inputHeight, outputFbo, pool, intermediate);
+        };
+        return node;
+    }
+
+    // of the last apply(): full-screen passes, bilinear fetches per side and pass, resolution divisor
+    int passes() const {
+        return lastPasses;
+    }
+
+    int taps() const {
+        return lastTaps;
+    }
+
+    int divisor() const {
+        return lastDivisor;
+    }
+
+private:
+    Shader* shader = nullptr;
+    float sigma1080;
+    int lastPasses = 0;
+    int lastTaps = 0;
+    int lastDivisor = 1;
+
+    // plain bilinear fetch (down- and upsampling): a single tap of weight 1
+    void setSingleTap() {
+        float one = 1.0f, zero = 0.0f;
+        glUniform1fv(shader->location("offsets"), 1, &zero);
+        glUniform1fv(shader->location("weights"), 1, &one);
+        shader->setInt("taps", 1);
+    }
+
+    void draw(GLuint source, GLuint fbo, int width, int height, const glm::vec2& direction) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+        shader->setVec2("direction", direction);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+};
+
+// Dual-Kawase blur (Bjorge, "Bandwidth-efficient rendering", SIGGRAPH 2015): a chain of
+// 5-fetch downsamples to 1/2, 1/4, ... 1/2^levels of the screen and 8-fetch upsamples back. Each
+// level doubles the radius while the pixels touched shrink by four, so even very wide blurs cost
+// about 1.3 full-screen passes worth of bandwidth. The number of levels follows the sigma:
+// ceil(log2(sigma)) (an approximation, the kernel is not exactly Gaussian), 1 to 8.
+class DualKawaseBlur {
+public:
+    DualKawaseBlur(ShaderCompileQueue& queue, const char* quadVertexPath, float sigma = 8.0f) : sigma1080(sigma) {
+        ShaderSources sources;
+        sources.vertex = ShaderPreprocessor::process(quadVertexPath);
+        sources.fragment = ShaderPreprocessor::process("./shaders/kawaseDownShader.fs");
+        downShader = &queue.add(sources);
+        sources.fragment = ShaderPreprocessor::process("./shaders/kawaseUpShader.fs");
+        upShader = &queue.add(sources);
+    }
+
+    void setSigma(float sigma) {
+        sigma1080 = sigma;
+    }
+
+    float sigma() const {
+        return sigma1080;
+    }
+
+    static int levelsFor(float sigma) {
+        return std::min(std::max((int)std::ceil(std::log2(std::max(sigma, 1.0f))), 1), 8);
+    }
+
+    void apply(GLuint input, int inputWidth, int inputHeight, GLuint outputFbo, RenderTargetPool& pool, const RenderTargetDesc& intermediate) {
+        int levels = levelsFor(sigma1080 * pool.height() / 1080.0f);
+        RenderTargetDesc desc = intermediate;
+
+        // down: input -> 1/2 -> ... -> 1/2^levels, each level released once the next has read it
+        downShader->use();
+        downShader->setInt("screenTexture", 0);
+        GLuint source = input;
+        int sourceWidth = inputWidth, sourceHeight = inputHeight;
+        RenderTarget* previous = nullptr;
+        for (int level = 1; level <= levels; level++) {
+            desc.divisor = 1 << level;
+            RenderTarget* target = pool.acquire(desc);
+            draw(*downShader, source, sourceWidth, sourceHeight, target->fbo, target->width, target->height);
+            if (previous)
+                pool.release(previous);
+            previous = target;
+            source = target->color;
+            sourceWidth = target->width;
+            sourceHeight = target->height;
+        }
+
+        // up: 1/2^levels -> ... -> 1/2 -> output (the pool hands the released down targets back)
+        upShader->use();
+        upShader->setInt("screenTexture", 0);
+        for (int level = levels - 1; level >= 0; level--) {
+            desc.divisor = 1 << level;
+            RenderTarget* target = level > 0 ? pool.acquire(desc) : nullptr;
+            draw(*upShader, source, sourceWidth, sourceHeight, target ? target->fbo : outputFbo,
+                target ? target->width : pool.width(), target ? target->height : pool.height());
+            pool.release(previous);
+            previous = target;
+            if (target) {
+                source = target->color;
+                sourceWidth = target->width;
+                sourceHeight = target->height;
+            }
+        }
+        lastLevels = levels;
+    }
+
+    PostEffect effect(const std::string& name = "kawase") {
+        PostEffect node;
+        node.name = name;
+        node.kind = PostEffect::Filter;
+        node.filter = [this](GLuint input, int inputWidth, int inputHeight, GLuint outputFbo, RenderTargetPool& pool, const RenderTargetDesc& intermediate) {
+            apply(input, inputWidth, inputHeight, outputFbo, pool, intermediate);
+        };
+        return node;
+    }
+
+    // of the last apply(); it drew 2 * levels passes
+    int levels() const {
+        return lastLevels;
+    }
+
+private:
+    Shader* downShader = nullptr;
+    Shader* upShader = nullptr;
+    float sigma1080;
+    int lastLevels = 0;
+
+    static void draw(Shader& shader, GLuint source, int sourceWidth, int sourceHeight, GLuint fbo, int width, int height) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+        shader.setVec2("halfPixel", 0.5f / sourceWidth, 0.5f / sourceHeight);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+};
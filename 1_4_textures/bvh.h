@@ -0,0 +1,476 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "occlusion_buffer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+// Bounding volume hierarchy over bounding spheres (scene objects or instances), for culling and
+// queries that cost about log(n) per visible cluster instead of one test per object.
+//
+// Nodes are axis-aligned boxes. Every node covers a contiguous range of order[], so a node that
+// is entirely inside the frustum hands out its whole range without testing the objects in it.
+//
+//  - build(): median split on the longest axis of the centres. The top levels are split on the
+//    calling thread until there are a few subtrees per worker, which are then built in parallel
+//    and appended to the node array. Children always come after their parent.
+//  - refit(): for objects that moved. Keeps the tree and recomputes every box bottom-up (per
+//    subtree in parallel). The boxes grow as neighbours drift apart; refitCost() compares the
+//    summed box areas with those right after build(), so callers can rebuild once it gets bad.
+//  - cull(): frustum traversal with a plane mask. Planes a box is fully inside of are not tested
+//    again below it. The subtrees from build() are traversed in parallel. With an OcclusionBuffer,
+//    a box hidden behind the occluders drops its whole subtree as well.
+//  - querySphere() and raycast(): range and nearest-hit queries.
+//
+// It is used like InstanceCuller: resize(count), setSphere(i, ...) for every object, build(),
+// then cull() and writeVisible() every frame. writeVisible() writes the visible objects in tree
+// order, which keeps neighbours in space next to each other.
+class BoundingVolumeHierarchy {
+public:
+    struct Stats {
+        size_t tested = 0;         // objects tested individually
+        size_t nodesVisited = 0;
+        size_t visible = 0;
+        size_t occluded = 0;       // objects inside the frustum but hidden behind the occluders
+        double cullMs = 0.0;       // cull() + writeVisible() of the last frame
+    };
+
+    struct RayHit {
+        uint32_t index = 0;        // object index passed to setSphere()
+        float distance = 0.0f;
+    };
+
+    void resize(size_t count) {
+        spheres.assign(count, glm::vec4(0.0f, 0.0f, 0.0f, -1.0f));
+        nodes.clear();
+        subtrees.clear();
+        visibleObjects.clear();
+    }
+
+    // safe from several threads at once for different objects
+    void setSphere(size_t index, const glm::vec3& center, float radius) {
+        spheres[index] = glm::vec4(center, radius);
+    }
+
+    size_t size() const {
+        return spheres.size();
+    }
+
+    size_t nodeCount() const {
+        return nodes.size();
+    }
+
+    // rebuild the whole tree from the current spheres
+    void build(ThreadPool& pool) {
+        uint32_t count = (uint32_t)spheres.size();
+        order.resize(count);
+        std::iota(order.begin(), order.end(), 0u);
+        nodes.clear();
+        subtrees.clear();
+        if (count == 0)
+            return;
+
+        // split on this thread until the pieces are small enough to give one to each job
+        size_t jobs = (size_t)pool.size() * 4;
+        uint32_t subtreeSize = (uint32_t)std::max<size_t>(LeafSize, (count + jobs - 1) / jobs);
+        std::vector<uint32_t> pending;
+        buildNode(nodes, 0, count, subtreeSize, &pending);
+        topCount = (uint32_t)nodes.size();
+
+        std::vector<std::vector<Node>> built(pending.size());
+        pool.parallelFor(pending.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const Node& root = nodes[pending[i]];
+                buildNode(built[i], root.first, root.count, 0, nullptr);
+            }
+        });
+
+        // append every subtree; its local node 0 replaces the placeholder left in the top levels
+        for (size_t i = 0; i < pending.size(); i++) {
+            uint32_t root = pending[i];
+            uint32_t base = (uint32_t)nodes.size() - 1;
+            auto remap = [&](uint32_t local) { return local == 0 ? root : base + local; };
+            Subtree subtree = { root, (uint32_t)nodes.size(), 0 };
+            for (uint32_t local = 0; local < built[i].size(); local++) {
+                Node node = built[i][local];
+                if (!node.isLeaf()) {
+                    node.left = remap(node.left);
+                    node.right = remap(node.right);
+                }
+                if (local == 0)
+                    nodes[root] = node;
+                else
+                    nodes.push_back(node);
+            }
+            subtree.end = (uint32_t)nodes.size();
+            subtrees.push_back(subtree);
+        }
+        builtCost = surfaceAreaSum();
+    }
+
+    // recompute every box for the current spheres without changing the tree
+    void refit(ThreadPool& pool) {
+        if (nodes.empty())
+            return;
+        pool.parallelFor(subtrees.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                for (uint32_t n = subtrees[i].end; n-- > subtrees[i].begin; )
+                    refitNode(n);
+                refitNode(subtrees[i].root);
+            }
+        });
+        for (uint32_t n = topCount; n-- > 0; )
+            refitNode(n);
+    }
+
+    // summed box areas now / right after build(): 1 for a fresh tree, growing as objects move
+    float refitCost() const {
+        return builtCost > 0.0f ? surfaceAreaSum() / builtCost : 1.0f;
+    }
+
+    // returns the number of visible objects; writeVisible() then outputs them in tree order.
+    // 'occlusion' (optional) must already be rendered for this camera.
+    size_t cull(const Frustum& frustum, ThreadPool& pool, const OcclusionBuffer* occlusion = nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        visibleObjects.clear();
+        lastStats = Stats();
+        if (!nodes.empty()) {
+            // the top levels on this thread; subtrees that are not fully inside or outside are
+            // handed to the pool with the planes they still have to be tested against
+            std::vector<SubtreeJob> jobs;
+            Traversal top;
+            traverse(frustum, occlusion, 0, AllPlanes, top, &jobs);
+
+            std::vector<Traversal> results(jobs.size());
+            pool.parallelFor(jobs.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    traverse(frustum, occlusion, jobs[i].node, jobs[i].planeMask, results[i], nullptr);
+            });
+
+            merge(top);
+            for (const Traversal& result : results)
+                merge(result);
+        }
+        lastStats.visible = visibleObjects.size();
+        lastStats.cullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return visibleObjects.size();
+    }
+
+    // copy the data of the visible objects, in tree order, to out[0 .. visible): 'stride' bytes
+    // per object in 'instances' and in 'out'
+    void writeVisible(const void* instances, size_t stride, void* out, ThreadPool& pool) {
+        auto start = std::chrono::steady_clock::now();
+        const char* src = static_cast<const char*>(instances);
+        char* dst = static_cast<char*>(out);
+        pool.parallelFor(visibleObjects.size(), 1024, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                std::memcpy(dst + i * stride, src + visibleObjects[i] * stride, stride);
+        });
+        lastStats.cullMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // object indices of the last cull(), in tree order
+    const std::vector<uint32_t>& visibleIndices() const {
+        return visibleObjects;
+    }
+
+    const Stats& stats() const {
+        return lastStats;
+    }
+
+    // xyz = center, w = radius
+    glm::vec4 sphere(size_t index) const {
+        return spheres[index];
+    }
+
+    // every object whose sphere overlaps the sphere (center, radius)
+    void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const {
+        if (nodes.empty())
+            return;
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            glm::vec3 closest = glm::max(node.min, glm::min(center, node.max));
+            glm::vec3 d = closest - center;
+            if (glm::dot(d, d) > radius * radius)
+                continue;
+            if (node.isLeaf()) {
+                for (uint32_t k = node.first; k < node.first + node.count; k++) {
+                    const glm::vec4& s = spheres[order[k]];
+                    glm::vec3 e = glm::vec3(s) - center;
+                    float reach = radius + s.w;
+                    if (s.w >= 0.0f && glm::dot(e, e) <= reach * reach)
+                        out.push_back(order[k]);
+                }
+                continue;
+            }
+            stack[top++] = node.left;
+            stack[top++] = node.right;
+        }
+    }
+
+    // nearest object hit by the ray origin + t * direction, 0 <= t <= maxDistance
+    // ('direction' must be normalised)
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const {
+        if (nodes.empty())
+            return false;
+        glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        bool found = false;
+        float nearest = maxDistance;
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (!rayHitsBox(origin, inverse, node, nearest))
+                continue;
+            if (node.isLeaf()) {
+                for (uint32_t k = node.first; k < node.first + node.count; k++) {
+                    float t;
+                    if (raySphere(origin, direction, spheres[order[k]], t) && t <= nearest) {
+                        nearest = t;
+                        hit.index = order[k];
+                        hit.distance = t;
+                        found = true;
+                    }
+                }
+                continue;
+            }
+            stack[top++] = node.left;
+            stack[top++] = node.right;
+        }
+        return found;
+    }
+
+private:
+    static const uint32_t LeafSize = 8;
+    static const uint32_t AllPlanes = (1u << Frustum::Count) - 1;
+
+    // a leaf has left == right == 0 (no node can point back at the root)
+    struct Node {
+        glm::vec3 min;
+        uint32_t first = 0;   // range of order[] covered by this node
+        glm::vec3 max;
+        uint32_t count = 0;
+        uint32_t left = 0;
+        uint32_t right = 0;
+
+        bool isLeaf() const {
+            return left == 0;
+        }
+    };
+
+    // a subtree built by one job: its root sits in the top levels, the rest in nodes[begin, end)
+    struct Subtree {
+        uint32_t root;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    struct SubtreeJob {
+        uint32_t node;
+        uint32_t planeMask;
+    };
+
+    struct Traversal {
+        std::vector<uint32_t> visible;
+        size_t tested = 0;
+        size_t nodesVisited = 0;
+        size_t occluded = 0;
+    };
+
+    std::vector<glm::vec4> spheres;   // xyz = center, w = radius, by object index
+    std::vector<uint32_t> order;      // object indices in tree order
+    std::vector<Node> nodes;
+    std::vector<Subtree> subtrees;
+    uint32_t topCount = 0;            // nodes[0, topCount) are the top levels
+    float builtCost = 0.0f;
+    std::vector<uint32_t> visibleObjects;
+    Stats lastStats;
+
+    // build the subtree over order[first, first + count) into 'out' and return its index. With a
+    // 'pending' list, ranges of at most 'subtreeSize' objects become placeholder nodes listed
+    // there instead (their box is already set).
+    uint32_t buildNode(std::vector<Node>& out, uint32_t first, uint32_t count, uint32_t subtreeSize, std::vector<uint32_t>* pending) {
+        uint32_t index = (uint32_t)out.size();
+        out.emplace_back();
+
+        Node node;
+        node.first = first;
+        node.count = count;
+        node.min = glm::vec3(INFINITY);
+        node.max = glm::vec3(-INFINITY);
+        glm::vec3 centerMin(INFINITY), centerMax(-INFINITY);
+        for (uint32_t k = first; k < first + count; k++) {
+            const glm::vec4& s = spheres[order[k]];
+            glm::vec3 c(s);
+            node.min = glm::min(node.min, c - glm::vec3(s.w));
+            node.max = glm::max(node.max, c + glm::vec3(s.w));
+            centerMin = glm::min(centerMin, c);
+            centerMax = glm::max(centerMax, c);
+        }
+        out[index] = node;
+
+        glm::vec3 extent = centerMax - centerMin;
+        if (count <= LeafSize || (extent.x <= 0.0f && extent.y <= 0.0f && extent.z <= 0.0f))
+            return index;
+        if (pending != nullptr && count <= subtreeSize) {
+            pending->push_back(index);
+            return index;
+        }
+
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        uint32_t middle = first + count / 2;
+        std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+            [&](uint32_t a, uint32_t b) { return spheres[a][axis] < spheres[b][axis]; });
+
+        uint32_t left = buildNode(out, first, middle - first, subtreeSize, pending);
+        uint32_t right = buildNode(out, middle, first + count - middle, subtreeSize, pending);
+        out[index].left = left;
+        out[index].right = right;
+        return index;
+    }
+
+    void refitNode(uint32_t index) {
+        Node& node = nodes[index];
+        if (node.isLeaf()) {
+            node.min = glm::vec3(INFINITY);
+            node.max = glm::vec3(-INFINITY);
+            for (uint32_t k = node.first; k < node.first + node.count; k++) {
+                const glm::vec4& s = spheres[order[k]];
+                node.min = glm::min(node.min, glm::vec3(s) - glm::vec3(s.w));
+                node.max = glm::max(node.max, glm::vec3(s) + glm::vec3(s.w));
+            }
+        }
+        else {
+            node.min = glm::min(nodes[node.left].min, nodes[node.right].min);
+            node.max = glm::max(nodes[node.left].max, nodes[node.right].max);
+        }
+    }
+
+    float surfaceAreaSum() const {
+        float sum = 0.0f;
+        for (const Node& node : nodes) {
+            glm::vec3 e = glm::max(node.max - node.min, glm::vec3(0.0f));
+            sum += e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+        return sum;
+    }
+
+    bool isSubtreeRoot(uint32_t index) const {
+        for (const Subtree& subtree : subtrees)
+            if (subtree.root == index)
+                return true;
+        return false;
+    }
+
+    // Depth-first frustum traversal from 'start'. With 'jobs', subtree roots that still need
+    // testing are queued there instead of being descended into.
+    void traverse(const Frustum& frustum, const OcclusionBuffer* occlusion, uint32_t start, uint32_t startMask,
+        Traversal& result, std::vector<SubtreeJob>* jobs) const {
+        SubtreeJob stack[64];
+        int top = 0;
+        stack[top++] = SubtreeJob{ start, startMask };
+        while (top > 0) {
+            SubtreeJob item = stack[--top];
+            const Node& node = nodes[item.node];
+            result.nodesVisited++;
+
+            // box against the planes still in the mask: outside one -> culled, inside one -> drop it
+            uint32_t mask = item.planeMask;
+            glm::vec3 center = (node.min + node.max) * 0.5f;
+            glm::vec3 extent = (node.max - node.min) * 0.5f;
+            bool outside = false;
+            for (int p = 0; p < Frustum::Count && !outside; p++) {
+                if (!(mask & (1u << p)))
+                    continue;
+                const Plane& plane = frustum.planes[p];
+                float d = plane.signedDistance(center);
+                float r = glm::dot(glm::abs(plane.normal), extent);
+                if (d + r < 0.0f)
+                    outside = true;
+                else if (d - r >= 0.0f)
+                    mask &= ~(1u << p);
+            }
+            if (outside)
+                continue;
+            if (occlusion != nullptr && occlusion->boxOccluded(node.min, node.max)) {
+                result.occluded += node.count;
+                continue;
+            }
+
+            if (mask == 0 && occlusion == nullptr) {
+                // fully inside: everything below is visible, except unset spheres (radius < 0)
+                for (uint32_t k = node.first; k < node.first + node.count; k++)
+                    if (spheres[order[k]].w >= 0.0f)
+                        result.visible.push_back(order[k]);
+                continue;
+            }
+            if (node.isLeaf()) {
+                for (uint32_t k = node.first; k < node.first + node.count; k++) {
+                    const glm::vec4& s = spheres[order[k]];
+                    result.tested++;
+                    bool inside = s.w >= 0.0f;
+                    for (int p = 0; p < Frustum::Count && inside; p++)
+                        if ((mask & (1u << p)) && frustum.planes[p].signedDistance(glm::vec3(s)) < -s.w)
+                            inside = false;
+                    if (!inside)
+                        continue;
+                    if (occlusion != nullptr && occlusion->sphereOccluded(glm::vec3(s), s.w))
+                        result.occluded++;
+                    else
+                        result.visible.push_back(order[k]);
+                }
+                continue;
+            }
+            if (jobs != nullptr && item.node != start && isSubtreeRoot(item.node)) {
+                jobs->push_back(SubtreeJob{ item.node, mask });
+                continue;
+            }
+            stack[top++] = SubtreeJob{ node.right, mask };
+            stack[top++] = SubtreeJob{ node.left, mask };
+        }
+    }
+
+    void merge(const Traversal& result) {
+        visibleObjects.insert(visibleObjects.end(), result.visible.begin(), result.visible.end());
+        lastStats.tested += result.tested;
+        lastStats.nodesVisited += result.nodesVisited;
+        lastStats.occluded += result.occluded;
+    }
+
+    static bool rayHitsBox(const glm::vec3& origin, const glm::vec3& inverse, const Node& node, float maxDistance) {
+        glm::vec3 t0 = (node.min - origin) * inverse;
+        glm::vec3 t1 = (node.max - origin) * inverse;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        return enter <= exit;
+    }
+
+    static bool raySphere(const glm::vec3& origin, const glm::vec3& direction, const glm::vec4& sphere, float& t) {
+        if (sphere.w < 0.0f)
+            return false;
+        glm::vec3 oc = origin - glm::vec3(sphere);
+        float b = glm::dot(oc, direction);
+        float c = glm::dot(oc, oc) - sphere.w * sphere.w;
+        float discriminant = b * b - c;
+        if (discriminant < 0.0f)
+            return false;
+        float root = std::sqrt(discriminant);
+        t = -b - root;
+        if (t < 0.0f)
+            t = -b + root; // origin inside the sphere
+        return t >= 0.0f;
+    }
+};
@@ -4,6 +4,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "frustum.h"
+
+#include <atomic>
+#include <memory>
 #include <vector>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -21,53 +25,201 @@ const float SPEED = 2.5f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
 
+// Everything a frame needs to know about the camera, frozen at Camera::Publish(). Immutable, so
+// the culling workers and any other thread can read it while the main thread keeps moving the camera.
+struct CameraSnapshot {
+    unsigned long long frame = 0;   // Publish() counter
+    glm::vec3 position;
+    glm::vec3 front;
+    glm::vec3 up;
+    glm::vec3 right;
+    float zoom = ZOOM;
+    float aspect = 1.0f;
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::mat4 inverseView;
+    glm::mat4 inverseProjection;
+    glm::mat4 inverseViewProjection;
+    Frustum frustum;                // world space
+
+    // sub-pixel offset for temporal anti-aliasing (Camera::SetJitter); the matrices above are
+    // unjittered (culling, LOD and reprojection need the stable ones), only rasterize with this one
+    glm::vec2 jitter = glm::vec2(0.0f);
+    glm::mat4 jitteredProjection;
+};
 
 // An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
+//
+// The matrices are cached: input only marks what it invalidates (the direction vectors, the view,
+// the projection) and each value is rebuilt on first use after that, so a frame with several
+// rotate steps runs the trigonometry once and a frame without input recomputes nothing.
 class Camera
 {
 public:
-    // camera Attributes
-    glm::vec3 Position;
-    glm::vec3 Front;
-    glm::vec3 Up;
-    glm::vec3 Right;
-    glm::vec3 WorldUp;
-    // euler Angles
-    float Yaw;
-    float Pitch;
     // camera options
     float MovementSpeed;
     float MouseSensitivity;
-    float Zoom;
 
     // constructor with vectors
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY)
     {
         Position = position;
         WorldUp = up;
         Yaw = yaw;
         Pitch = pitch;
-        updateCameraVectors();
     }
     // constructor with scalar values
-    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY)
     {
         Position = glm::vec3(posX, posY, posZ);
         WorldUp = glm::vec3(upX, upY, upZ);
         Yaw = yaw;
         Pitch = pitch;
-        updateCameraVectors();
     }
 
+    // perspective parameters besides the field of view (which is Zoom); call again when the window is resized
+    void SetProjection(float aspect, float nearPlane, float farPlane)
+    {
+        if (aspect == Aspect && nearPlane == NearPlane && farPlane == FarPlane)
+            return;
+        Aspect = aspect;
+        NearPlane = nearPlane;
+        FarPlane = farPlane;
+        dirty |= ProjectionDirty;
+    }
+
+    void SetPosition(const glm::vec3& position)
+    {
+        Position = position;
+        dirty |= ViewDirty;
+    }
+
+    // angles in degrees
+    void SetOrientation(float yaw, float pitch)
+    {
+        Yaw = yaw;
+        Pitch = pitch;
+        dirty |= VectorsDirty | ViewDirty;
+    }
+
+    void SetZoom(float zoom)
+    {
+        Zoom = zoom;
+        dirty |= ProjectionDirty;
+    }
+
+    // offset of the next published jitteredProjection, in NDC units (2 / width is one pixel);
+    // (0, 0) for an unjittered image
+    void SetJitter(const glm::vec2& jitter)
+    {
+        Jitter = jitter;
+    }
+
+    const glm::vec3& GetPosition() const { return Position; }
+    float GetYaw() const { return Yaw; }
+    float GetPitch() const { return Pitch; }
+    float GetZoom() const { return Zoom; }
+    float GetAspect() const { return Aspect; }
+    float GetNearPlane() const { return NearPlane; }
+    float GetFarPlane() const { return FarPlane; }
+
+    const glm::vec3& GetFront() const { updateCameraVectors(); return Front; }
+    const glm::vec3& GetUp() const { updateCameraVectors(); return Up; }
+    const glm::vec3& GetRight() const { updateCameraVectors(); return Right; }
+
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+    const glm::mat4& GetViewMatrix() const
+    {
+        updateMatrices();
+        return View;
+    }
+
+    const glm::mat4& GetProjectionMatrix() const
+    {
+        updateMatrices();
+        return Projection;
+    }
+
+    const glm::mat4& GetViewProjectionMatrix() const
+    {
+        updateMatrices();
+        return ViewProjection;
+    }
+
+    const glm::mat4& GetInverseViewMatrix() const
+    {
+        updateMatrices();
+        return InverseView;
+    }
+
+    const glm::mat4& GetInverseProjectionMatrix() const
+    {
+        updateMatrices();
+        return InverseProjection;
+    }
+
+    const glm::mat4& GetInverseViewProjectionMatrix() const
+    {
+        updateMatrices();
+        return InverseViewProjection;
+    }
+
+    // world-space frustum of the current view and projection
+    const Frustum& GetFrustum() const
+    {
+        updateMatrices();
+        return CachedFrustum;
+    }
+
+    // Freeze the current state for this frame. Hand the returned snapshot to the threads that work
+    // on this frame: reading it never locks, it is never written again, and readers holding an
+    // older snapshot keep it alive until they let go of it. The snapshot is also kept as the latest
+    // one for GetSnapshot().
+    std::shared_ptr<const CameraSnapshot> Publish()
+    {
+        updateMatrices();
+        std::shared_ptr<CameraSnapshot> snapshot = std::make_shared<CameraSnapshot>();
+        snapshot->frame = ++PublishCount;
+        snapshot->position = Position;
+        snapshot->front = Front;
+        snapshot->up = Up;
+        snapshot->right = Right;
+        snapshot->zoom = Zoom;
+        snapshot->aspect = Aspect;
+        snapshot->nearPlane = NearPlane;
+        snapshot->farPlane = FarPlane;
+        snapshot->view = View;
+        snapshot->projection = Projection;
+        snapshot->viewProjection = ViewProjection;
+        snapshot->inverseView = InverseView;
+        snapshot->inverseProjection = InverseProjection;
+        snapshot->inverseViewProjection = InverseViewProjection;
+        snapshot->frustum = CachedFrustum;
+        snapshot->jitter = Jitter;
+        // a translation of clip space by jitter * w: every vertex moves by exactly 'jitter' in NDC
+        snapshot->jitteredProjection = glm::translate(glm::mat4(1.0f), glm::vec3(Jitter.x, Jitter.y, 0.0f)) * Projection;
+
+        std::shared_ptr<const CameraSnapshot> published = snapshot;
+        std::atomic_store(&Latest, published);
+        return published;
+    }
+
+    // the last published snapshot (nullptr before the first Publish()); safe from any thread, but
+    // not lock-free: the atomic shared_ptr functions take a short internal lock on MSVC and
+    // libstdc++ (std::atomic_is_lock_free is false). Prefer passing Publish()'s result along.
+    std::shared_ptr<const CameraSnapshot> GetSnapshot() const
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        return std::atomic_load(&Latest);
     }
 
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
+        updateCameraVectors();
         float velocity = MovementSpeed * deltaTime;
         if (direction == FORWARD)
             Position += Front * velocity;
@@ -77,11 +229,15 @@ public:
             Position -= Right * velocity;
         if (direction == RIGHT)
             Position += Right * velocity;
+        dirty |= ViewDirty;
     }
 
     // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
     void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true)
     {
+        if (xoffset == 0.0f && yoffset == 0.0f)
+            return;
+
         xoffset *= MouseSensitivity;
         yoffset *= MouseSensitivity;
 
@@ -97,8 +253,8 @@ public:
                 Pitch = -89.0f;
         }
 
-        // update Front, Right and Up Vectors using the updated Euler angles
-        updateCameraVectors();
+        // Front, Right and Up are recalculated from the updated Euler angles when next needed
+        dirty |= VectorsDirty | ViewDirty;
     }
 
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
@@ -109,12 +265,50 @@ public:
             Zoom = 1.0f;
         if (Zoom > 45.0f)
             Zoom = 45.0f;
+        dirty |= ProjectionDirty;
     }
 
 private:
+    enum : unsigned int {
+        VectorsDirty = 1u << 0,
+        ViewDirty = 1u << 1,
+        ProjectionDirty = 1u << 2,
+    };
+
+    // camera Attributes
+    glm::vec3 Position;
+    glm::vec3 WorldUp;
+    // euler Angles
+    float Yaw;
+    float Pitch;
+    float Zoom = ZOOM;
+    // perspective
+    float Aspect = 1.0f;
+    float NearPlane = 0.1f;
+    float FarPlane = 100.0f;
+    glm::vec2 Jitter = glm::vec2(0.0f);
+
+    // derived values, rebuilt lazily (hence mutable: the getters are const)
+    mutable unsigned int dirty = VectorsDirty | ViewDirty | ProjectionDirty;
+    mutable glm::vec3 Front = glm::vec3(0.0f, 0.0f, -1.0f);
+    mutable glm::vec3 Up;
+    mutable glm::vec3 Right;
+    mutable glm::mat4 View;
+    mutable glm::mat4 Projection;
+    mutable glm::mat4 ViewProjection;
+    mutable glm::mat4 InverseView;
+    mutable glm::mat4 InverseProjection;
+    mutable glm::mat4 InverseViewProjection;
+    mutable Frustum CachedFrustum;
+
+    unsigned long long PublishCount = 0;
+    std::shared_ptr<const CameraSnapshot> Latest;
+
     // calculates the front vector from the Camera's (updated) Euler Angles
-    void updateCameraVectors()
+    void updateCameraVectors() const
     {
+        if (!(dirty & VectorsDirty))
+            return;
         // calculate the new Front vector
         glm::vec3 front;
         front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
@@ -124,5 +318,27 @@ private:
         // also re-calculate the Right and Up vector
         Right = glm::normalize(glm::cross(Front, WorldUp));  // normalize the vectors, because their length gets closer to 0 the more you look up or down which results in slower movement.
         Up = glm::normalize(glm::cross(Right, Front));
+        dirty &= ~VectorsDirty;
     }
-};
\ No newline at end of file
+
+    void updateMatrices() const
+    {
+        updateCameraVectors();
+        if (!(dirty & (ViewDirty | ProjectionDirty)))
+            return;
+
+        if (dirty & ViewDirty) {
+            View = glm::lookAt(Position, Position + Front, Up);
+            // rigid transform: the inverse is the transposed rotation and the position
+            InverseView = glm::mat4(glm::vec4(Right, 0.0f), glm::vec4(Up, 0.0f), glm::vec4(-Front, 0.0f), glm::vec4(Position, 1.0f));
+        }
+        if (dirty & ProjectionDirty) {
+            Projection = glm::perspective(glm::radians(Zoom), Aspect, NearPlane, FarPlane);
+            InverseProjection = glm::inverse(Projection);
+        }
+        ViewProjection = Projection * View;
+        InverseViewProjection = InverseView * InverseProjection;
+        CachedFrustum = Frustum::fromMatrix(ViewProjection);
+        dirty &= ~(ViewDirty | ProjectionDirty);
+    }
+};
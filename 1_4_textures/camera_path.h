@@ -0,0 +1,204 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "camera.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// camera state at one point in time (angles in degrees, like Camera)
+struct CameraKey {
+    float time = 0.0f;
+    glm::vec3 position;
+    float yaw = YAW;
+    float pitch = PITCH;
+    float zoom = ZOOM;
+
+    static CameraKey capture(float time, const Camera& camera) {
+        CameraKey key;
+        key.time = time;
+        key.position = camera.GetPosition();
+        key.yaw = camera.GetYaw();
+        key.pitch = camera.GetPitch();
+        key.zoom = camera.GetZoom();
+        return key;
+    }
+
+    // t = 0 -> a, t = 1 -> b
+    static CameraKey lerp(const CameraKey& a, const CameraKey& b, float t) {
+        CameraKey key;
+        key.time = glm::mix(a.time, b.time, t);
+        key.position = glm::mix(a.position, b.position, t);
+        key.yaw = glm::mix(a.yaw, b.yaw, t);
+        key.pitch = glm::mix(a.pitch, b.pitch, t);
+        key.zoom = glm::mix(a.zoom, b.zoom, t);
+        return key;
+    }
+
+    void applyTo(Camera& camera) const {
+        camera.SetPosition(position);
+        camera.SetOrientation(yaw, pitch);
+        camera.SetZoom(zoom);
+    }
+};
+
+// A camera track that can be recorded from a live session, saved, loaded and played back, so
+// benchmark runs see exactly the same views every time. Playback samples the track at a
+// simulated time (frame * fixed step), not at wall-clock time, so a slow build renders the same
+// frames as a fast one.
+//
+// File format: one key per line, "time x y z yaw pitch zoom"; lines starting with '#' are comments.
+class CameraPath {
+public:
+    std::vector<CameraKey> keys;
+
+    void clear() {
+        keys.clear();
+    }
+
+    void record(float time, const Camera& camera) {
+        keys.push_back(CameraKey::capture(time, camera));
+    }
+
+    float duration() const {
+        return keys.empty() ? 0.0f : keys.back().time;
+    }
+
+    // linear interpolation between the two keys around 'time', clamped to the ends
+    CameraKey sample(float time) const {
+        if (keys.empty())
+            return CameraKey();
+        if (time <= keys.front().time)
+            return keys.front();
+        if (time >= keys.back().time)
+            return keys.back();
+
+        size_t lo = 0, hi = keys.size() - 1;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (keys[mid].time <= time)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        const CameraKey& a = keys[lo];
+        const CameraKey& b = keys[hi];
+        float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0.0f;
+        return CameraKey::lerp(a, b, t);
+    }
+
+    void apply(float time, Camera& camera) const {
+        sample(time).applyTo(camera);
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream file(path);
+        if (!file) {
+            std::cout << "ERROR::CAMERA_PATH::FILE_NOT_WRITABLE: " << path << std::endl;
+            return false;
+        }
+        file << "# time x y z yaw pitch zoom\n";
+        for (const CameraKey& key : keys)
+            file << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z << " "
+                << key.yaw << " " << key.pitch << " " << key.zoom << "\n";
+        return true;
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cout << "ERROR::CAMERA_PATH::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        keys.clear();
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream in(line);
+            CameraKey key;
+            if (in >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch >> key.zoom)
+                keys.push_back(key);
+        }
+        return !keys.empty();
+    }
+
+    // -- scripted flythroughs of the asteroid scene (planet at the origin, belt of radius ~50) --
+
+    // circle the whole scene, looking at the planet
+    static CameraPath orbit(float seconds = 20.0f) {
+        return scripted(seconds, [](float t, glm::vec3& eye, glm::vec3& target) {
+            float angle = t * glm::two_pi<float>();
+            eye = glm::vec3(std::cos(angle) * 90.0f, 25.0f, std::sin(angle) * 90.0f);
+            target = glm::vec3(0.0f);
+        });
+    }
+
+    // fly along the belt through the rocks, looking ahead: the densest view for the instancing path
+    static CameraPath flyThroughBelt(float seconds = 30.0f) {
+        return scripted(seconds, [](float t, glm::vec3& eye, glm::vec3& target) {
+            float angle = t * glm::two_pi<float>();
+            float ahead = angle + 0.2f;
+            eye = glm::vec3(std::cos(angle) * 50.0f, 0.5f + std::sin(angle * 3.0f), std::sin(angle) * 50.0f);
+            target = glm::vec3(std::cos(ahead) * 50.0f, 0.0f, std::sin(ahead) * 50.0f);
+        });
+    }
+
+    // approach the planet until it fills the screen: few rocks, large close-up surfaces
+    static CameraPath closeUpPlanet(float seconds = 15.0f) {
+        return scripted(seconds, [](float t, glm::vec3& eye, glm::vec3& target) {
+            float distance = glm::mix(70.0f, 9.0f, t);
+            float angle = 0.5f + t * 1.2f;
+            eye = glm::vec3(std::cos(angle) * distance, -3.0f + distance * 0.2f, std::sin(angle) * distance);
+            target = glm::vec3(0.0f, -3.0f, 0.0f);
+        });
+    }
+
+    // "orbit", "belt" or "planet"; an empty path for anything else
+    static CameraPath builtin(const std::string& name) {
+        if (name == "orbit")
+            return orbit();
+        if (name == "belt")
+            return flyThroughBelt();
+        if (name == "planet")
+            return closeUpPlanet();
+        std::cout << "ERROR::CAMERA_PATH::UNKNOWN_PATH: " << name << " (orbit, belt, planet)" << std::endl;
+        return CameraPath();
+    }
+
+private:
+    // sample eyeAndTarget(t in [0, 1]) 30 times per second into look-at keys
+    template<typename F>
+    static CameraPath scripted(float seconds, F eyeAndTarget) {
+        CameraPath path;
+        unsigned int count = (unsigned int)(seconds * 30.0f);
+        float previousYaw = 0.0f;
+        for (unsigned int i = 0; i <= count; i++) {
+            float t = (float)i / (float)count;
+            glm::vec3 eye, target;
+            eyeAndTarget(t, eye, target);
+            glm::vec3 direction = glm::normalize(target - eye);
+
+            CameraKey key;
+            key.time = t * seconds;
+            key.position = eye;
+            key.yaw = glm::degrees(std::atan2(direction.z, direction.x));
+            key.pitch = glm::degrees(std::asin(direction.y));
+            // keep yaw continuous so interpolation never spins the long way round
+            if (i > 0) {
+                while (key.yaw - previousYaw > 180.0f)
+                    key.yaw -= 360.0f;
+                while (key.yaw - previousYaw < -180.0f)
+                    key.yaw += 360.0f;
+            }
+            previousYaw = key.yaw;
+            path.keys.push_back(key);
+        }
+        return path;
+    }
+};
@@ -0,0 +1,132 @@
+#pragma once
+#include <GLFW/glfw3.h>
+
+#include "camera.h"
+#include "camera_path.h"
+#include "input_queue.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+// The camera as a simulation that advances in fixed steps, independent of the frame rate.
+//
+// advance(now) runs as many steps of 'step' seconds as fit in the time since the last call;
+// each step first applies the queued input events stamped up to its end time, then moves the
+// camera for the keys held during the step. Rendering happens between two steps, so the render
+// camera is interpolated between the last two simulated states (interpolated()): motion stays
+// smooth at any frame rate, and a slow frame only means more steps next time, not a bigger one.
+//
+// The simulation reads nothing but its queue and its own state, so it can later move to a thread
+// of its own; the render side would then only read the two CameraKeys.
+class CameraSimulation {
+public:
+    // keyboard look (I/J/K/L), in mouse-offset units per second
+    float keyboardLookSpeed = 300.0f;
+
+    explicit CameraSimulation(const Camera& initial, double step = 1.0 / 120.0) : simulated(initial), stepSeconds(step) {
+        previous = current = CameraKey::capture(0.0f, simulated);
+        std::fill(std::begin(held), std::end(held), false);
+    }
+
+    // returns the number of steps run
+    unsigned int advance(double now, InputQueue& queue) {
+        if (simulatedTime < 0.0)
+            simulatedTime = now;
+        // after a long stall (loading, dragging the window) skip ahead instead of running
+        // hundreds of steps in one frame
+        if (now - simulatedTime > MaxCatchUp)
+            simulatedTime = now - MaxCatchUp;
+
+        unsigned int steps = 0;
+        while (simulatedTime + stepSeconds <= now) {
+            double end = simulatedTime + stepSeconds;
+            queue.drain(end, events);
+            for (const InputEvent& event : events)
+                handle(event);
+            tick();
+            simulatedTime = end;
+            previous = current;
+            current = CameraKey::capture((float)simulatedTime, simulated);
+            steps++;
+        }
+        alpha = (float)((now - simulatedTime) / stepSeconds);
+        return steps;
+    }
+
+    // the camera state to render now, between the last two steps
+    CameraKey interpolated() const {
+        return CameraKey::lerp(previous, current, alpha);
+    }
+
+    double step() const {
+        return stepSeconds;
+    }
+
+    const Camera& camera() const {
+        return simulated;
+    }
+
+private:
+    static constexpr double MaxCatchUp = 0.25; // seconds
+
+    Camera simulated;
+    double stepSeconds;
+    double simulatedTime = -1.0;
+    float alpha = 0.0f;
+    CameraKey previous, current;
+
+    std::vector<InputEvent> events;
+    bool held[512];
+    bool firstMouse = true;
+    double lastX = 0.0, lastY = 0.0;
+
+    bool isHeld(int key) const {
+        return key >= 0 && key < 512 && held[key];
+    }
+
+    void handle(const InputEvent& event) {
+        switch (event.type) {
+        case InputEvent::Key:
+            if (event.key >= 0 && event.key < 512 && event.action != GLFW_REPEAT)
+                held[event.key] = event.action == GLFW_PRESS;
+            break;
+        case InputEvent::CursorPos:
+            if (firstMouse) {
+                lastX = event.x;
+                lastY = event.y;
+                firstMouse = false;
+            }
+            // y reversed since y-coordinates go from bottom to top
+            simulated.ProcessMouseMovement((float)(event.x - lastX), (float)(lastY - event.y));
+            lastX = event.x;
+            lastY = event.y;
+            break;
+        case InputEvent::Scroll:
+            simulated.ProcessMouseScroll((float)event.y);
+            break;
+        }
+    }
+
+    void tick() {
+        float dt = (float)stepSeconds;
+        if (isHeld(GLFW_KEY_W))
+            simulated.ProcessKeyboard(FORWARD, dt);
+        if (isHeld(GLFW_KEY_S))
+            simulated.ProcessKeyboard(BACKWARD, dt);
+        if (isHeld(GLFW_KEY_A))
+            simulated.ProcessKeyboard(LEFT, dt);
+        if (isHeld(GLFW_KEY_D))
+            simulated.ProcessKeyboard(RIGHT, dt);
+
+        float look = keyboardLookSpeed * dt;
+        if (isHeld(GLFW_KEY_I))
+            simulated.ProcessMouseMovement(0.0f, look);
+        if (isHeld(GLFW_KEY_K))
+            simulated.ProcessMouseMovement(0.0f, -look);
+        if (isHeld(GLFW_KEY_J))
+            simulated.ProcessMouseMovement(-look, 0.0f);
+        if (isHeld(GLFW_KEY_L))
+            simulated.ProcessMouseMovement(look, 0.0f);
+    }
+};
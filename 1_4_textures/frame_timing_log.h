@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Per-frame CPU and GPU times of a benchmark run. GPU times arrive a few frames after the CPU
+// times (see GpuTimer), so both are stored by frame index and written out together at the end:
+// a CSV with one row per frame plus a summary on stdout, to compare builds run over the same
+// camera path.
+class FrameTimingLog {
+public:
+    void cpu(unsigned long long frame, double ms) {
+        at(frame).cpuMs = ms;
+    }
+
+    void gpu(unsigned long long frame, double ms) {
+        at(frame).gpuMs = ms;
+    }
+
+    size_t frames() const {
+        return rows.size();
+    }
+
+    bool writeCsv(const std::string& path) const {
+        std::ofstream file(path);
+        if (!file) {
+            std::cout << "ERROR::FRAME_TIMING_LOG::FILE_NOT_WRITABLE: " << path << std::endl;
+            return false;
+        }
+        file << "frame,cpu_ms,gpu_ms\n";
+        for (size_t i = 0; i < rows.size(); i++) {
+            file << i << "," << rows[i].cpuMs << ",";
+            if (rows[i].gpuMs >= 0.0)
+                file << rows[i].gpuMs;
+            file << "\n";
+        }
+        return true;
+    }
+
+    void printSummary(const std::string& title) const {
+        std::vector<double> cpuMs, gpuMs;
+        for (const Row& row : rows) {
+            if (row.cpuMs >= 0.0)
+                cpuMs.push_back(row.cpuMs);
+            if (row.gpuMs >= 0.0)
+                gpuMs.push_back(row.gpuMs);
+        }
+        std::cout << title << ": " << rows.size() << " frames" << std::endl;
+        printLine("  CPU", cpuMs);
+        printLine("  GPU", gpuMs);
+    }
+
+private:
+    struct Row {
+        double cpuMs = -1.0;   // -1 = not measured
+        double gpuMs = -1.0;
+    };
+    std::vector<Row> rows;
+
+    Row& at(unsigned long long frame) {
+        if (frame >= rows.size())
+            rows.resize((size_t)frame + 1);
+        return rows[(size_t)frame];
+    }
+
+    static void printLine(const char* label, std::vector<double> ms) {
+        if (ms.empty()) {
+            std::cout << label << ": no samples" << std::endl;
+            return;
+        }
+        std::sort(ms.begin(), ms.end());
+        double sum = 0.0;
+        for (double v : ms)
+            sum += v;
+        std::cout << label << ": avg " << sum / ms.size() << " ms, median " << ms[ms.size() / 2]
+            << " ms, 95th " << ms[std::min(ms.size() - 1, ms.size() * 95 / 100)]
+            << " ms, max " << ms.back() << " ms" << std::endl;
+    }
+};
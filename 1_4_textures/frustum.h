@@ -0,0 +1,61 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// bounds of a mesh or an instance
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius = 0.0f;
+};
+
+// plane: dot(normal, p) + distance = 0, normal points into the frustum
+struct Plane {
+    glm::vec3 normal;
+    float distance = 0.0f;
+
+    float signedDistance(const glm::vec3& p) const {
+        return glm::dot(normal, p) + distance;
+    }
+};
+
+// The six planes of a view frustum, in world space when built from projection * view
+// (Gribb & Hartmann: every plane is the last row of the matrix plus or minus one of the others).
+struct Frustum {
+    enum { Left, Right, Bottom, Top, Near, Far, Count };
+    Plane planes[Count];
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection) {
+        const glm::mat4& m = viewProjection;
+        // glm is column-major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum f;
+        f.set(Left, row3 + row0);
+        f.set(Right, row3 - row0);
+        f.set(Bottom, row3 + row1);
+        f.set(Top, row3 - row1);
+        f.set(Near, row3 + row2);
+        f.set(Far, row3 - row2);
+        return f;
+    }
+
+    // true if any part of the sphere may be visible (conservative near the frustum corners)
+    bool intersectsSphere(const glm::vec3& center, float radius) const {
+        for (int i = 0; i < Count; i++)
+            if (planes[i].signedDistance(center) < -radius)
+                return false;
+        return true;
+    }
+
+private:
+    // normalised, so signedDistance() is a real distance and can be compared with a radius
+    void set(int index, const glm::vec4& p) {
+        float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        planes[index].normal = glm::vec3(p.x, p.y, p.z) / length;
+        planes[index].distance = p.w / length;
+    }
+};
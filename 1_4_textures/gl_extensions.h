@@ -0,0 +1,141 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+
+// glad in this project is generated for the 3.3 core profile only, so entry points from newer
+// versions / extensions that we use as optional fast paths are loaded here by hand.
+// Every feature has a flag; callers must check it and keep a 3.3 fallback.
+
+// GL 4.1 / ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// KHR/ARB_parallel_shader_compile
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// GL 4.4 / ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+// GL 4.0 / ARB_draw_indirect
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// GL 4.4 / ARB_query_buffer_object
+#ifndef GL_QUERY_BUFFER
+#define GL_QUERY_BUFFER 0x9192
+#endif
+
+typedef void (APIENTRYP PFN_glGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFN_glProgramBinary)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFN_glProgramParameteri)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFN_glMaxShaderCompilerThreads)(GLuint count);
+typedef void (APIENTRYP PFN_glBufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP PFN_glDrawElementsIndirect)(GLenum mode, GLenum type, const void* indirect);
+
+struct GLExtensions {
+    int major = 3;
+    int minor = 3;
+
+    // program binaries (GL 4.1 or ARB_get_program_binary, and at least one binary format)
+    bool programBinary = false;
+    PFN_glGetProgramBinary GetProgramBinary = nullptr;
+    PFN_glProgramBinary ProgramBinary = nullptr;
+    PFN_glProgramParameteri ProgramParameteri = nullptr;
+
+    // background shader compilation, queried with GL_COMPLETION_STATUS_KHR
+    bool parallelShaderCompile = false;
+    PFN_glMaxShaderCompilerThreads MaxShaderCompilerThreads = nullptr;
+
+    // immutable storage, needed for persistently mapped buffers
+    bool bufferStorage = false;
+    PFN_glBufferStorage BufferStorage = nullptr;
+
+    // draw parameters (count, instance count, ...) read by the GPU from a buffer
+    bool drawIndirect = false;
+    PFN_glDrawElementsIndirect DrawElementsIndirect = nullptr;
+
+    // glGetQueryObject* writes the result into the buffer bound to GL_QUERY_BUFFER instead of
+    // returning it to the CPU
+    bool queryBufferObject = false;
+
+    bool atLeast(int reqMajor, int reqMinor) const {
+        return major > reqMajor || (major == reqMajor && minor >= reqMinor);
+    }
+};
+
+inline bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++) {
+        const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (ext != nullptr && std::strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+template<typename T>
+inline T loadGLProc(const char* name) {
+    return reinterpret_cast<T>(glfwGetProcAddress(name));
+}
+
+inline GLExtensions loadGLExtensions() {
+    GLExtensions ext;
+    glGetIntegerv(GL_MAJOR_VERSION, &ext.major);
+    glGetIntegerv(GL_MINOR_VERSION, &ext.minor);
+
+    if (ext.atLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) {
+        ext.GetProgramBinary = loadGLProc<PFN_glGetProgramBinary>("glGetProgramBinary");
+        ext.ProgramBinary = loadGLProc<PFN_glProgramBinary>("glProgramBinary");
+        ext.ProgramParameteri = loadGLProc<PFN_glProgramParameteri>("glProgramParameteri");
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        ext.programBinary = ext.GetProgramBinary && ext.ProgramBinary && ext.ProgramParameteri && formats > 0;
+    }
+
+    if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+        ext.MaxShaderCompilerThreads = loadGLProc<PFN_glMaxShaderCompilerThreads>("glMaxShaderCompilerThreadsKHR");
+    else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+        ext.MaxShaderCompilerThreads = loadGLProc<PFN_glMaxShaderCompilerThreads>("glMaxShaderCompilerThreadsARB");
+    ext.parallelShaderCompile = ext.MaxShaderCompilerThreads != nullptr;
+
+    if (ext.atLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage"))
+        ext.BufferStorage = loadGLProc<PFN_glBufferStorage>("glBufferStorage");
+    ext.bufferStorage = ext.BufferStorage != nullptr;
+
+    if (ext.atLeast(4, 0) || hasGLExtension("GL_ARB_draw_indirect"))
+        ext.DrawElementsIndirect = loadGLProc<PFN_glDrawElementsIndirect>("glDrawElementsIndirect");
+    ext.drawIndirect = ext.DrawElementsIndirect != nullptr;
+
+    ext.queryBufferObject = ext.atLeast(4, 4) || hasGLExtension("GL_ARB_query_buffer_object");
+    return ext;
+}
+
+// loaded on first use, so a GL context must be current by then (after gladLoadGLLoader)
+inline const GLExtensions& glExtensions() {
+    static const GLExtensions ext = loadGLExtensions();
+    return ext;
+}
@@ -0,0 +1,219 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gl_extensions.h"
+#include "frustum.h"
+#include "instance_format.h"
+#include "model.h"
+#include "shader_s.h"
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Frustum culling of instances on the GPU, for belts too large to test on the CPU every frame.
+// Needs nothing beyond GL 3.3: a geometry shader and transform feedback.
+//
+// cull() draws every instance as one point with GL_RASTERIZER_DISCARD. instanceCullShader tests
+// the instance's bounding sphere and emits only the visible ones, which transform feedback packs
+// into outputBuffer(). The instance data never goes back to the CPU; the draw only needs the
+// number of survivors, counted by a GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN query:
+//  - GL 4.4 (ARB_query_buffer_object) with draw indirect: the GPU writes the query result into
+//    the instanceCount of one DrawElementsIndirect command per mesh, so nothing waits.
+//  - GL 3.3: draw() reads the query result, which waits until the culling pass (not the rest of
+//    the frame) is done. Issue cull() early in the frame to hide it.
+// glDrawTransformFeedbackInstanced skips the query too, but it uses the feedback count as the
+// vertex count of a non-indexed draw, which does not fit indexed meshes drawn once per instance.
+//
+// Matrix instances come out as Matrix; Quat and PackedHalf come out as Quat (the vertex fetch has
+// already expanded the half floats), so the draw shader is the same INSTANCE_QUAT variant.
+//
+// The output buffer is attached to the model (Model::AttachInstanceBuffer) for as long as the
+// culler lives, so draw() goes through the model's instanced VAOs and textures.
+//
+//     culler.cull(instanceBuffer, offset, count, frustum);   // early in the frame
+//     ...
+//     culler.draw(shader);                                   // an INSTANCED shader
+class GpuInstanceCuller {
+public:
+    struct Stats {
+        GLuint visible = 0;   // on the indirect path: from a few frames ago, read without waiting
+        double waitMs = 0.0;  // CPU time spent waiting for the query result in the last draw()
+    };
+
+    GpuInstanceCuller(Model& model, InstanceFormat inputFormat, size_t capacity)
+        : model(model), inputFormat(inputFormat), capacity(capacity), program(sources(inputFormat)) {
+        const GLExtensions& ext = glExtensions();
+        indirect = ext.drawIndirect && ext.queryBufferObject;
+
+        BoundingSphere sphere = model.GetBoundingSphere();
+        program.use();
+        program.setVec4("meshSphere", glm::vec4(sphere.center, sphere.radius));
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        for (unsigned int location = 0; location < instanceAttributeCount(inputFormat); location++)
+            glEnableVertexAttribArray(location); // divisor 0: one point per instance
+        glBindVertexArray(0);
+
+        glGenBuffers(1, &output);
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, output);
+        glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, capacity * instanceStride(outputFormat()), NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+        model.AttachInstanceBuffer(output, outputFormat());
+
+        glGenQueries(QueryCount, queries);
+
+        if (indirect) {
+            std::vector<DrawElementsIndirectCommand> commands(model.meshes.size());
+            for (size_t i = 0; i < commands.size(); i++)
+                commands[i].count = (GLuint)model.meshes[i].indices.size();
+            glGenBuffers(1, &commandBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+    }
+
+    ~GpuInstanceCuller() {
+        model.DetachInstanceBuffer(output);
+        glDeleteQueries(QueryCount, queries);
+        glDeleteBuffers(1, &output);
+        if (commandBuffer)
+            glDeleteBuffers(1, &commandBuffer);
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    GpuInstanceCuller(const GpuInstanceCuller&) = delete;
+    GpuInstanceCuller& operator=(const GpuInstanceCuller&) = delete;
+
+    // cull 'count' instances stored in 'instances' from byte 'offset' on (in the input format)
+    void cull(GLuint instances, GLintptr offset, size_t count, const Frustum& frustum) {
+        if (count > capacity)
+            count = capacity;
+
+        // a query is reused QueryCount frames later; by then its result is normally available
+        query = (query + 1) % QueryCount;
+        if (indirect && queryUsed[query]) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+                glGetQueryObjectuiv(queries[query], GL_QUERY_RESULT, &lastStats.visible);
+        }
+        queryUsed[query] = true;
+
+        glm::vec4 planes[Frustum::Count];
+        for (int p = 0; p < Frustum::Count; p++)
+            planes[p] = glm::vec4(frustum.planes[p].normal, frustum.planes[p].distance);
+        program.use();
+        glUniform4fv(program.location("planes"), Frustum::Count, &planes[0].x);
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, instances);
+        setInstanceAttributes(inputFormat, 0, offset);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, output);
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, queries[query]);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+        glEndTransformFeedback();
+        glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+        glDisable(GL_RASTERIZER_DISCARD);
+
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+
+        if (indirect) {
+            // the GPU copies the count into every command once the culling pass is done
+            glBindBuffer(GL_QUERY_BUFFER, commandBuffer);
+            for (size_t i = 0; i < model.meshes.size(); i++) {
+                GLintptr field = i * sizeof(DrawElementsIndirectCommand) + offsetof(DrawElementsIndirectCommand, instanceCount);
+                glGetQueryObjectuiv(queries[query], GL_QUERY_RESULT, (GLuint*)field);
+            }
+            glBindBuffer(GL_QUERY_BUFFER, 0);
+        }
+    }
+
+    // draw the model's meshes with the survivors of the last cull(), with an INSTANCED 'shader'
+    // (INSTANCE_QUAT unless outputFormat() is Matrix)
+    void draw(Shader& shader) {
+        if (!indirect) {
+            GLuint visible = 0;
+            auto start = std::chrono::steady_clock::now();
+            glGetQueryObjectuiv(queries[query], GL_QUERY_RESULT, &visible);
+            lastStats.waitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            lastStats.visible = visible;
+            model.DrawInstanced(shader, output, visible);
+            return;
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        for (size_t i = 0; i < model.meshes.size(); i++) {
+            model.BindInstanced(shader, i, output);
+            glExtensions().DrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(i * sizeof(DrawElementsIndirectCommand)));
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    InstanceFormat outputFormat() const {
+        return inputFormat == InstanceFormat::Matrix ? InstanceFormat::Matrix : InstanceFormat::Quat;
+    }
+
+    GLuint outputBuffer() const {
+        return output;
+    }
+
+    // true when the count stays on the GPU (query buffer + draw indirect)
+    bool isIndirect() const {
+        return indirect;
+    }
+
+    const Stats& stats() const {
+        return lastStats;
+    }
+
+private:
+    // layout fixed by glDrawElementsIndirect
+    struct DrawElementsIndirectCommand {
+        GLuint count = 0;
+        GLuint instanceCount = 0;
+        GLuint firstIndex = 0;
+        GLint baseVertex = 0;
+        GLuint baseInstance = 0;
+    };
+
+    static const unsigned int QueryCount = 4;
+
+    Model& model;
+    InstanceFormat inputFormat;
+    size_t capacity;
+    Shader program;
+    bool indirect = false;
+    GLuint vao = 0;
+    GLuint output = 0;
+    GLuint commandBuffer = 0;
+    GLuint queries[QueryCount] = {};
+    bool queryUsed[QueryCount] = {};
+    unsigned int query = 0;
+    Stats lastStats;
+
+    static ShaderSources sources(InstanceFormat inputFormat) {
+        ShaderDefines defines;
+        if (inputFormat != InstanceFormat::Matrix)
+            defines["INSTANCE_QUAT"] = "1";
+        ShaderSources sources;
+        sources.vertex = ShaderPreprocessor::process("./shaders/instanceCullShader.vs", defines);
+        sources.geometry = ShaderPreprocessor::process("./shaders/instanceCullShader.gs", defines);
+        sources.feedbackVaryings = { "instanceData0", "instanceData1" };
+        if (inputFormat == InstanceFormat::Matrix) {
+            sources.feedbackVaryings.push_back("instanceData2");
+            sources.feedbackVaryings.push_back("instanceData3");
+        }
+        return sources;
+    }
+};
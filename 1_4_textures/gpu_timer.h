@@ -0,0 +1,155 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <vector>
+
+// Results of one kind of GL query (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ...) over a span of
+// commands. Results arrive a few frames late, so the queries live in a ring: begin()/end() use
+// the next slot, collect() hands over every result that is ready without blocking, and a slot is
+// only waited for if the ring wraps around before its result is in (latency frames behind).
+// With GL_TIMESTAMP a slot is a pair of glQueryCounter() stamps and the value their difference in
+// nanoseconds: unlike a GL_TIME_ELAPSED query, such a span may lie inside another timed span.
+//
+//     samples.begin(frame);  ... draw ...  samples.end();
+//     for (const GpuQueryRing::Result& r : samples.collect())  use(r.tag, r.value);
+class GpuQueryRing {
+public:
+    struct Result {
+        unsigned long long tag;
+        GLuint64 value;
+    };
+
+    explicit GpuQueryRing(GLenum target, unsigned int latency = 4)
+        : target(target), queries(target == GL_TIMESTAMP ? 2 * latency : latency), tags(latency), pending(latency, false) {
+        glGenQueries((GLsizei)queries.size(), queries.data());
+    }
+
+    ~GpuQueryRing() {
+        glDeleteQueries((GLsizei)queries.size(), queries.data());
+    }
+
+    GpuQueryRing(const GpuQueryRing&) = delete;
+    GpuQueryRing& operator=(const GpuQueryRing&) = delete;
+
+    void begin(unsigned long long tag) {
+        if (pending[next])
+            read(next); // ring wrapped before the GPU finished: blocks
+        tags[next] = tag;
+        if (target == GL_TIMESTAMP)
+            glQueryCounter(queries[next], GL_TIMESTAMP);
+        else
+            glBeginQuery(target, queries[next]);
+    }
+
+    void end() {
+        if (target == GL_TIMESTAMP)
+            glQueryCounter(queries[lastQuery(next)], GL_TIMESTAMP);
+        else
+            glEndQuery(target);
+        pending[next] = true;
+        next = (next + 1) % tags.size();
+    }
+
+    // results that became available since the last call, oldest first
+    std::vector<Result> collect() {
+        for (size_t i = 0; i < tags.size(); i++) {
+            size_t slot = (next + i) % tags.size();
+            if (!pending[slot])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[lastQuery(slot)], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break; // later slots were issued later, keep the order
+            read(slot);
+        }
+        std::vector<Result> out;
+        out.swap(ready);
+        return out;
+    }
+
+    // wait for every outstanding query, e.g. at the end of a benchmark
+    std::vector<Result> drain() {
+        for (size_t i = 0; i < tags.size(); i++) {
+            size_t slot = (next + i) % tags.size();
+            if (pending[slot])
+                read(slot);
+        }
+        std::vector<Result> out;
+        out.swap(ready);
+        return out;
+    }
+
+private:
+    GLenum target;
+    std::vector<GLuint> queries;   // one per slot; with GL_TIMESTAMP the begin stamps, then the end stamps
+    std::vector<unsigned long long> tags;
+    std::vector<bool> pending;
+    std::vector<Result> ready;
+    size_t next = 0;
+
+    // the query of a slot that completes last
+    size_t lastQuery(size_t slot) const {
+        return target == GL_TIMESTAMP ? tags.size() + slot : slot;
+    }
+
+    void read(size_t slot) {
+        Result result;
+        result.tag = tags[slot];
+        result.value = 0;
+        glGetQueryObjectui64v(queries[lastQuery(slot)], GL_QUERY_RESULT, &result.value);
+        if (target == GL_TIMESTAMP) {
+            GLuint64 start = 0;
+            glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &start);
+            result.value -= start;
+        }
+        ready.push_back(result);
+        pending[slot] = false;
+    }
+};
+
+// GPU time of a span of commands, measured with GL_TIME_ELAPSED queries (core since GL 3.3), or
+// with 'nested' by timestamps, for spans inside one that is already measured.
+//
+//     timer.begin(frame);  ... draw ...  timer.end();
+//     for (const GpuTimer::Result& r : timer.collect())  use(r.tag, r.ms);
+class GpuTimer {
+public:
+    struct Result {
+        unsigned long long tag;
+        double ms;
+    };
+
+    explicit GpuTimer(unsigned int latency = 4, bool nested = false) : ring(nested ? GL_TIMESTAMP : GL_TIME_ELAPSED, latency) {
+    }
+
+    void begin(unsigned long long tag) {
+        ring.begin(tag);
+    }
+
+    void end() {
+        ring.end();
+    }
+
+    std::vector<Result> collect() {
+        return toMs(ring.collect());
+    }
+
+    std::vector<Result> drain() {
+        return toMs(ring.drain());
+    }
+
+private:
+    GpuQueryRing ring;
+
+    static std::vector<Result> toMs(const std::vector<GpuQueryRing::Result>& results) {
+        std::vector<Result> out;
+        out.reserve(results.size());
+        for (const GpuQueryRing::Result& r : results) {
+            Result result;
+            result.tag = r.tag;
+            result.ms = r.value / 1.0e6;
+            out.push_back(result);
+        }
+        return out;
+    }
+};
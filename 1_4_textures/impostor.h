@@ -0,0 +1,237 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "instance_format.h"
+#include "model.h"
+#include "shader_s.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Far-field stand-ins for an instanced model (the tiers of instance_lod.h):
+//
+//  - Octahedral impostor: the model is rendered once, at startup, from frames x frames directions
+//    spread over the whole sphere into one atlas. The directions are the cells of an octahedral
+//    map (y up): a direction d is folded onto the octahedron |x|+|y|+|z| = 1 and its upper half
+//    unfolded into the square, the lower half into the corners. drawImpostors() draws one quad per
+//    instance; the vertex shader turns the view direction into the instance's model space, picks
+//    the nearest atlas frame and orients the quad the way that frame was captured, so the instance
+//    rotation is kept. The C++ and GLSL octahedral functions must stay the same.
+//  - Point: drawPoints() draws one GL_POINTS vertex per instance with gl_PointSize set to the
+//    projected diameter, in the average colour of the atlas.
+//
+// Both read the same instance data as the mesh (any InstanceFormat, attributes from
+// InstanceAttributeLocation on); unlike Model::DrawInstanced, 'offset' is in bytes.
+//
+//     OctahedralImpostor impostor(rock, format, bakeShader);   // bakeShader: the non-instanced model shader
+//     impostor.drawImpostors(buffer, offset, count, view, projection, eye);
+//     impostor.drawPoints(buffer, offset, count, view, projection, pixelScale);
+class OctahedralImpostor {
+public:
+    OctahedralImpostor(Model& model, InstanceFormat format, Shader& bakeShader, int frames = 8, int frameSize = 64)
+        : format(format), frames(frames), frameSize(frameSize),
+          impostorProgram(sources("./shaders/impostorShader.vs", "./shaders/impostorShader.fs", format)),
+          pointProgram(sources("./shaders/impostorPointShader.vs", "./shaders/impostorPointShader.fs", format)) {
+        BoundingSphere sphere = model.GetBoundingSphere();
+        meshSphere = glm::vec4(sphere.center, sphere.radius);
+        bake(model, bakeShader);
+
+        impostorProgram.use();
+        impostorProgram.setInt("atlas", 0);
+        impostorProgram.setFloat("frames", (float)frames);
+        impostorProgram.setVec4("meshSphere", meshSphere);
+        pointProgram.use();
+        pointProgram.setVec4("meshSphere", meshSphere);
+        pointProgram.setVec4("pointColor", averageColor);
+
+        // quad corners at location 0, instances from InstanceAttributeLocation (one quad per instance)
+        const float corners[] = { -1.0f, -1.0f,  1.0f, -1.0f,  -1.0f, 1.0f,  1.0f, 1.0f };
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        enableInstanceAttributes(format, InstanceAttributeLocation, 1);
+
+        // points: no vertex data, one vertex per instance
+        glGenVertexArrays(1, &pointVAO);
+        glBindVertexArray(pointVAO);
+        enableInstanceAttributes(format, InstanceAttributeLocation, 0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~OctahedralImpostor() {
+        glDeleteTextures(1, &atlas);
+        glDeleteBuffers(1, &quadVBO);
+        glDeleteVertexArrays(1, &quadVAO);
+        glDeleteVertexArrays(1, &pointVAO);
+    }
+
+    OctahedralImpostor(const OctahedralImpostor&) = delete;
+    OctahedralImpostor& operator=(const OctahedralImpostor&) = delete;
+
+    // 'count' instances stored in 'instances' from byte 'offset' on
+    void drawImpostors(GLuint instances, GLintptr offset, size_t count, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eye) {
+        if (count == 0)
+            return;
+        impostorProgram.use();
+        impostorProgram.setMatrix4("view", view);
+        impostorProgram.setMatrix4("projection", projection);
+        impostorProgram.setVec3("eye", eye);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, instances);
+        setInstanceAttributes(format, InstanceAttributeLocation, offset);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // pixelScale: pixels per unit at distance 1 (InstanceLod::pixelScale)
+    void drawPoints(GLuint instances, GLintptr offset, size_t count, const glm::mat4& view, const glm::mat4& projection, float pixelScale) {
+        if (count == 0)
+            return;
+        pointProgram.use();
+        pointProgram.setMatrix4("view", view);
+        pointProgram.setMatrix4("projection", projection);
+        pointProgram.setFloat("pixelScale", pixelScale);
+
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glBindVertexArray(pointVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, instances);
+        setInstanceAttributes(format, InstanceAttributeLocation, offset);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+
+    GLuint atlasTexture() const {
+        return atlas;
+    }
+
+    int atlasSize() const {
+        return frames * frameSize;
+    }
+
+    // direction -> [-1, 1]^2
+    static glm::vec2 octahedralEncode(const glm::vec3& d) {
+        glm::vec3 n = d * (1.0f / (std::fabs(d.x) + std::fabs(d.y) + std::fabs(d.z)));
+        glm::vec2 p(n.x, n.z);
+        if (n.y < 0.0f)
+            p = glm::vec2((1.0f - std::fabs(n.z)) * sign(n.x), (1.0f - std::fabs(n.x)) * sign(n.z));
+        return p;
+    }
+
+    // [-1, 1]^2 -> unit direction
+    static glm::vec3 octahedralDecode(const glm::vec2& p) {
+        glm::vec3 d(p.x, 1.0f - std::fabs(p.x) - std::fabs(p.y), p.y);
+        if (d.y < 0.0f) {
+            float x = (1.0f - std::fabs(p.y)) * sign(p.x);
+            float z = (1.0f - std::fabs(p.x)) * sign(p.y);
+            d.x = x;
+            d.z = z;
+        }
+        return glm::normalize(d);
+    }
+
+private:
+    InstanceFormat format;
+    int frames;
+    int frameSize;
+    Shader impostorProgram;
+    Shader pointProgram;
+    glm::vec4 meshSphere;
+    glm::vec4 averageColor = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+    GLuint atlas = 0;
+    GLuint quadVAO = 0, quadVBO = 0;
+    GLuint pointVAO = 0;
+
+    static float sign(float v) {
+        return v >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    // frame (i, j) looks at the model from octahedralDecode of the cell corner grid: the outer
+    // frames sit exactly on the edges of the map, so the poles and the equator are captured
+    void bake(Model& model, Shader& bakeShader) {
+        int size = atlasSize();
+        glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        GLuint depth, fbo;
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::IMPOSTOR:: bake framebuffer is not complete!" << std::endl;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glEnable(GL_DEPTH_TEST);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f); // alpha 0 outside the model: the impostor shader discards it
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        float r = meshSphere.w;
+        glm::vec3 center(meshSphere);
+        glm::mat4 projection = glm::ortho(-r, r, -r, r, 0.0f, 4.0f * r);
+        bakeShader.use();
+        bakeShader.setMatrix4("projection", projection);
+        bakeShader.setMatrix4("model", glm::mat4(1.0f));
+        for (int j = 0; j < frames; j++)
+            for (int i = 0; i < frames; i++) {
+                glm::vec3 d = octahedralDecode(glm::vec2(i, j) * (2.0f / (frames - 1)) - glm::vec2(1.0f));
+                glm::vec3 up = std::fabs(d.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                bakeShader.setMatrix4("view", glm::lookAt(center + d * (2.0f * r), center, up));
+                glViewport(i * frameSize, j * frameSize, frameSize, frameSize);
+                model.Draw(bakeShader);
+            }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (!depthTest)
+            glDisable(GL_DEPTH_TEST);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &depth);
+
+        // the background is black with alpha 0, so the mip levels are premultiplied: the shaders divide by alpha
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        GLint levels = 0;
+        while ((size >> (levels + 1)) > 0)
+            levels++;
+        unsigned char texel[4] = {};
+        glGetTexImage(GL_TEXTURE_2D, levels, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+        if (texel[3] > 0)
+            averageColor = glm::vec4(texel[0] / (float)texel[3], texel[1] / (float)texel[3], texel[2] / (float)texel[3], 1.0f);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    static ShaderSources sources(const char* vertexPath, const char* fragmentPath, InstanceFormat format) {
+        ShaderDefines defines = { { "INSTANCED", "1" } };
+        if (format != InstanceFormat::Matrix)
+            defines["INSTANCE_QUAT"] = "1";
+        ShaderSources sources;
+        sources.vertex = ShaderPreprocessor::process(vertexPath, defines);
+        sources.fragment = ShaderPreprocessor::process(fragmentPath, defines);
+        return sources;
+    }
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+// one input event, stamped with the time it happened (glfwGetTime() seconds)
+struct InputEvent {
+    enum Type { Key, CursorPos, Scroll };
+    Type type = Key;
+    double time = 0.0;
+    int key = 0;        // Key: GLFW_KEY_*
+    int action = 0;     // Key: GLFW_PRESS / GLFW_RELEASE / GLFW_REPEAT
+    double x = 0.0;     // CursorPos: position, Scroll: offsets
+    double y = 0.0;
+};
+
+// Input from the GLFW callbacks, kept until the simulation step that covers its timestamp.
+// The callbacks only push; nothing else happens in them, so input no longer changes the scene
+// in the middle of a frame. Pushing is locked, so events may come from any thread.
+class InputQueue {
+public:
+    void push(const InputEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+    }
+
+    // move the events with time <= 'until' to 'out', in time order
+    void drain(double until, std::vector<InputEvent>& out) {
+        out.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        std::stable_sort(events.begin(), events.end(), [](const InputEvent& a, const InputEvent& b) { return a.time < b.time; });
+        auto split = std::upper_bound(events.begin(), events.end(), until, [](double t, const InputEvent& e) { return t < e.time; });
+        out.assign(events.begin(), split);
+        events.erase(events.begin(), split);
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<InputEvent> events;
+};
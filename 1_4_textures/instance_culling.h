@@ -0,0 +1,243 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "occlusion_buffer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define INSTANCE_CULLING_SIMD "AVX"
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define INSTANCE_CULLING_SIMD "SSE"
+#else
+#define INSTANCE_CULLING_SIMD "scalar"
+#endif
+
+// Frustum culling of a fixed set of instances, each bounded by a sphere.
+//
+// The spheres are kept as a structure of arrays (x[], y[], z[], r[]), so one SIMD register holds
+// the same coordinate of 4 (SSE) or 8 (AVX, when compiled with /arch:AVX) instances and a plane
+// test is three multiply-adds and a compare for all of them. The instances are split into chunks
+// that are tested on the ThreadPool; every chunk writes its survivors into its own slice of the
+// index list, so no locking or atomics are needed, and a prefix sum over the chunk counts gives
+// each chunk its place in the compacted list of visible instances.
+//
+//     culler.resize(count);                              // once
+//     belt.evaluate(time, format, data, pool, &culler, sphere);   // setSphere() for every instance
+//     size_t visible = culler.cull(frustum, pool);       // or cull(frustum, pool, &occlusion)
+//     culler.writeVisible(data, stride, out, pool);      // out: room for 'visible' instances
+class InstanceCuller {
+public:
+    struct Stats {
+        size_t tested = 0;
+        size_t visible = 0;
+        size_t occluded = 0;   // inside the frustum but hidden behind the occluders
+        double cullMs = 0.0;   // cull() + writeVisible() of the last frame
+    };
+
+    // size the arrays once, then setSphere() every instance before the first cull() (and again
+    // before each cull() for instances that move)
+    void resize(size_t count) {
+        instanceCount = count;
+        size_t padded = (count + Lanes - 1) / Lanes * Lanes;
+        x.assign(padded, 0.0f);
+        y.assign(padded, 0.0f);
+        z.assign(padded, 0.0f);
+        r.assign(padded, -1e30f); // padding lanes fail every plane test
+
+        size_t chunks = (count + ChunkSize - 1) / ChunkSize;
+        indices.resize(chunks * ChunkSize);
+        chunkVisible.assign(chunks, 0);
+        chunkOccluded.assign(chunks, 0);
+        chunkOffset.assign(chunks, 0);
+        visibleList.clear();
+        visibleCount = 0;
+    }
+
+    // safe from several threads at once for different instances
+    void setSphere(size_t index, const glm::vec3& center, float radius) {
+        x[index] = center.x;
+        y[index] = center.y;
+        z[index] = center.z;
+        r[index] = radius;
+    }
+
+    // returns the number of visible instances; writeVisible() then outputs them in index order.
+    // With 'occlusion' (already rendered for this camera), instances that pass the frustum test
+    // are also dropped if they are hidden behind the occluders.
+    size_t cull(const Frustum& frustum, ThreadPool& pool, const OcclusionBuffer* occlusion = nullptr) {
+        auto start = std::chrono::steady_clock::now();
+
+        size_t chunks = chunkVisible.size();
+        pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++)
+                cullChunk(frustum, occlusion, chunk);
+        });
+
+        visibleCount = 0;
+        lastStats.occluded = 0;
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            chunkOffset[chunk] = visibleCount;
+            visibleCount += chunkVisible[chunk];
+            lastStats.occluded += chunkOccluded[chunk];
+        }
+        visibleList.resize(visibleCount);
+        pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++)
+                std::copy(&indices[chunk * ChunkSize], &indices[chunk * ChunkSize] + chunkVisible[chunk], visibleList.begin() + chunkOffset[chunk]);
+        });
+
+        lastStats.tested = instanceCount;
+        lastStats.visible = visibleCount;
+        lastStats.cullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return visibleCount;
+    }
+
+    // copy the visible instances, in index order, to out[0 .. visible): 'stride' bytes per
+    // instance in 'instances' and in 'out', whatever the instance format
+    void writeVisible(const void* instances, size_t stride, void* out, ThreadPool& pool) {
+        auto start = std::chrono::steady_clock::now();
+        const char* src = static_cast<const char*>(instances);
+        char* dst = static_cast<char*>(out);
+        pool.parallelFor(visibleList.size(), ChunkSize, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                std::memcpy(dst + i * stride, src + visibleList[i] * stride, stride);
+        });
+        lastStats.cullMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t visible() const {
+        return visibleCount;
+    }
+
+    // indices of the instances that survived the last cull(), in index order
+    const std::vector<uint32_t>& visibleIndices() const {
+        return visibleList;
+    }
+
+    // xyz = center, w = radius
+    glm::vec4 sphere(size_t index) const {
+        return glm::vec4(x[index], y[index], z[index], r[index]);
+    }
+
+    const Stats& stats() const {
+        return lastStats;
+    }
+
+    static const char* simdName() {
+        return INSTANCE_CULLING_SIMD;
+    }
+
+private:
+#if defined(__AVX__)
+    static const size_t Lanes = 8;
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+    static const size_t Lanes = 4;
+#else
+    static const size_t Lanes = 1;
+#endif
+    static const size_t ChunkSize = 1024; // instances per job, a multiple of Lanes
+
+    size_t instanceCount = 0;
+    std::vector<float> x, y, z, r;
+    std::vector<uint32_t> indices;     // survivors of chunk c start at c * ChunkSize
+    std::vector<size_t> chunkVisible;
+    std::vector<size_t> chunkOccluded;
+    std::vector<size_t> chunkOffset;   // exclusive prefix sum of chunkVisible
+    std::vector<uint32_t> visibleList;
+    size_t visibleCount = 0;
+    Stats lastStats;
+
+    void cullChunk(const Frustum& frustum, const OcclusionBuffer* occlusion, size_t chunk) {
+        size_t begin = chunk * ChunkSize;
+        size_t end = std::min(begin + ChunkSize, x.size());
+        uint32_t* out = &indices[begin];
+        size_t n = 0;
+        size_t occluded = 0;
+
+#if defined(__AVX__)
+        __m256 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count], d[Frustum::Count];
+        for (int p = 0; p < Frustum::Count; p++) {
+            nx[p] = _mm256_set1_ps(frustum.planes[p].normal.x);
+            ny[p] = _mm256_set1_ps(frustum.planes[p].normal.y);
+            nz[p] = _mm256_set1_ps(frustum.planes[p].normal.z);
+            d[p] = _mm256_set1_ps(frustum.planes[p].distance);
+        }
+        const __m256 zero = _mm256_setzero_ps();
+        for (size_t i = begin; i < end; i += Lanes) {
+            __m256 px = _mm256_loadu_ps(&x[i]);
+            __m256 py = _mm256_loadu_ps(&y[i]);
+            __m256 pz = _mm256_loadu_ps(&z[i]);
+            __m256 negRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(&r[i]));
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < Frustum::Count; p++) {
+                __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, nx[p]), _mm256_mul_ps(py, ny[p])),
+                    _mm256_add_ps(_mm256_mul_ps(pz, nz[p]), d[p]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negRadius, _CMP_GE_OQ));
+            }
+            int mask = _mm256_movemask_ps(inside);
+            while (mask) {
+                int lane = lowestBit(mask);
+                emit(occlusion, i + lane, out, n, occluded);
+                mask &= mask - 1;
+            }
+        }
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+        __m128 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count], d[Frustum::Count];
+        for (int p = 0; p < Frustum::Count; p++) {
+            nx[p] = _mm_set1_ps(frustum.planes[p].normal.x);
+            ny[p] = _mm_set1_ps(frustum.planes[p].normal.y);
+            nz[p] = _mm_set1_ps(frustum.planes[p].normal.z);
+            d[p] = _mm_set1_ps(frustum.planes[p].distance);
+        }
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t i = begin; i < end; i += Lanes) {
+            __m128 px = _mm_loadu_ps(&x[i]);
+            __m128 py = _mm_loadu_ps(&y[i]);
+            __m128 pz = _mm_loadu_ps(&z[i]);
+            __m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(&r[i]));
+            __m128 inside = _mm_cmpeq_ps(zero, zero); // all ones
+            for (int p = 0; p < Frustum::Count; p++) {
+                __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, nx[p]), _mm_mul_ps(py, ny[p])),
+                    _mm_add_ps(_mm_mul_ps(pz, nz[p]), d[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+            }
+            int mask = _mm_movemask_ps(inside);
+            while (mask) {
+                int lane = lowestBit(mask);
+                emit(occlusion, i + lane, out, n, occluded);
+                mask &= mask - 1;
+            }
+        }
+#else
+        for (size_t i = begin; i < end; i++)
+            if (frustum.intersectsSphere(glm::vec3(x[i], y[i], z[i]), r[i]))
+                emit(occlusion, i, out, n, occluded);
+#endif
+        chunkVisible[chunk] = n;
+        chunkOccluded[chunk] = occluded;
+    }
+
+    // instance i passed the frustum test: keep it unless the occluders hide it
+    void emit(const OcclusionBuffer* occlusion, size_t i, uint32_t* out, size_t& n, size_t& occluded) const {
+        if (occlusion != nullptr && occlusion->sphereOccluded(glm::vec3(x[i], y[i], z[i]), r[i]))
+            occluded++;
+        else
+            out[n++] = (uint32_t)i;
+    }
+
+    static int lowestBit(int mask) {
+        int lane = 0;
+        while (!(mask & (1 << lane)))
+            lane++;
+        return lane;
+    }
+};
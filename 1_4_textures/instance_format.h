@@ -0,0 +1,105 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// How one instance transform is stored in the instance buffer.
+//
+//  Matrix      64 bytes  mat4 at locations 7-10
+//  Quat        32 bytes  vec4 (position, uniform scale) at 7 + vec4 rotation quaternion at 8
+//  PackedHalf  16 bytes  the same two vec4s as half floats (position, scale) and snorm16
+//                        (quaternion); the vertex fetch expands them, so the shader is the
+//                        same as for Quat. Half precision is ~0.03 units at the belt radius of
+//                        50, well below a rock's size.
+//
+// The two compact formats need INSTANCE_QUAT defined in the shader (see model_matrix.glsl),
+// which rebuilds the matrix from the quaternion. They only hold rigid transforms with a uniform
+// scale, which is all the asteroid belt uses.
+enum class InstanceFormat {
+    Matrix,
+    Quat,
+    PackedHalf,
+};
+
+struct InstanceQuat {
+    glm::vec4 positionScale;   // xyz = position, w = scale
+    glm::vec4 rotation;        // unit quaternion, xyzw
+};
+
+struct InstancePackedHalf {
+    uint16_t positionScale[4]; // half floats
+    int16_t rotation[4];       // snorm16
+};
+
+inline const char* instanceFormatName(InstanceFormat format) {
+    switch (format) {
+    case InstanceFormat::Quat: return "quat";
+    case InstanceFormat::PackedHalf: return "half";
+    default: return "matrix";
+    }
+}
+
+// "matrix", "quat" or "half"; false for anything else
+inline bool parseInstanceFormat(const std::string& name, InstanceFormat& format) {
+    for (InstanceFormat f : { InstanceFormat::Matrix, InstanceFormat::Quat, InstanceFormat::PackedHalf }) {
+        if (name == instanceFormatName(f)) {
+            format = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline size_t instanceStride(InstanceFormat format) {
+    switch (format) {
+    case InstanceFormat::Quat: return sizeof(InstanceQuat);
+    case InstanceFormat::PackedHalf: return sizeof(InstancePackedHalf);
+    default: return sizeof(glm::mat4);
+    }
+}
+
+inline int16_t packSnorm16(float v) {
+    v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+    return (int16_t)std::lround(v * 32767.0f);
+}
+
+// first attribute location of the instance data: 0-6 are the mesh's own vertex attributes
+// (position, normal, texcoords, tangent, bitangent, bone ids and weights; see Mesh::setupMesh)
+const unsigned int InstanceAttributeLocation = 7;
+
+// number of consecutive attribute locations 'format' takes
+inline unsigned int instanceAttributeCount(InstanceFormat format) {
+    return format == InstanceFormat::Matrix ? 4 : 2;
+}
+
+// enable the instance attributes of the bound VAO (divisor 1: per instance, 0: per vertex)
+inline void enableInstanceAttributes(InstanceFormat format, unsigned int firstLocation, GLuint divisor) {
+    for (unsigned int location = firstLocation; location < firstLocation + instanceAttributeCount(format); location++) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, divisor);
+    }
+}
+
+// point the instance attributes of the bound VAO at 'offset' in the bound GL_ARRAY_BUFFER
+inline void setInstanceAttributes(InstanceFormat format, unsigned int firstLocation, GLintptr offset) {
+    GLsizei stride = (GLsizei)instanceStride(format);
+    switch (format) {
+    case InstanceFormat::Matrix:
+        for (unsigned int column = 0; column < 4; column++)
+            glVertexAttribPointer(firstLocation + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + column * sizeof(glm::vec4)));
+        break;
+    case InstanceFormat::Quat:
+        glVertexAttribPointer(firstLocation, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        glVertexAttribPointer(firstLocation + 1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + sizeof(glm::vec4)));
+        break;
+    case InstanceFormat::PackedHalf:
+        glVertexAttribPointer(firstLocation, 4, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+        glVertexAttribPointer(firstLocation + 1, 4, GL_SHORT, GL_TRUE, stride, (void*)(offset + 4 * sizeof(uint16_t)));
+        break;
+    }
+}
@@ -0,0 +1,234 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "random.h"
+#include "thread_pool.h"
+#include "instance_format.h"
+#include "instance_culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define INSTANCE_GENERATOR_SSE 1
+#endif
+
+// shape of the asteroid belt around the planet
+struct AsteroidBeltParams {
+    uint64_t seed = 1;
+    float radius = 50.0f;
+    float offset = 2.5f;            // random displacement in [-offset, offset) on each axis
+    float heightScale = 0.4f;       // keep height of asteroid field smaller compared to width of x and z
+    float minScale = 0.05f;
+    float maxScale = 0.25f;
+    glm::vec3 rotationAxis = glm::vec3(0.4f, 0.6f, 0.8f);
+    float orbitSpeed = 0.05f;       // radians per second at 'radius'; closer rocks are faster (Kepler)
+    float maxSpinSpeed = 1.0f;      // radians per second, each rock spins at a random rate up to this
+};
+
+// The asteroid belt as orbital elements: every rock has a start position, a scale, a start spin
+// angle and its orbit and spin speeds. evaluate(time) turns them into instance data at any time,
+// so the same belt is static (time 0) or animated.
+//
+// Generation runs in fixed chunks of 4096 and chunk c draws from its own stream,
+// Random(seed).split(c), so the belt depends only on the seed and the count, never on the number
+// of threads or on timing. For the same reason any whole chunks of a belt can be generated on
+// their own (the range constructor, used to stream huge belts piece by piece) and come out
+// exactly as in the full belt. Rock i sits at angle i / count around the belt, so a range of
+// rocks is also a sector of the belt (rangeBounds()).
+//
+// evaluate() writes straight into the requested InstanceFormat. The matrix is the closed form of
+// translate(position) * scale(s) * rotate(angle, axis): with the axis fixed, the rotation is
+//     R = cos * I + (1 - cos) * a a^T + sin * [a]x
+// so each column is scale * (cos * E + (1 - cos) * A + sin * K) with constant E, A, K columns,
+// two multiply-adds per column in SSE instead of three full 4x4 matrix products; the compact
+// formats only need the quaternion (a * sin(angle / 2), cos(angle / 2)).
+class AsteroidBelt {
+public:
+    static const size_t ChunkSize = 4096;
+
+    AsteroidBelt(const AsteroidBeltParams& params, size_t count, ThreadPool& pool) : params(params), total(count), count(count) {
+        setup();
+        const Random root(params.seed);
+        pool.parallelFor((count + ChunkSize - 1) / ChunkSize, 1, [&](size_t chunkBegin, size_t chunkEnd) {
+            for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++)
+                generateChunk(root, chunk);
+        });
+    }
+
+    // only rocks [first, first + rangeCount) of a belt of 'count' rocks, generated on the calling
+    // thread; 'first' must be a multiple of ChunkSize. Index 0 of this belt is rock 'first'.
+    AsteroidBelt(const AsteroidBeltParams& params, size_t count, size_t first, size_t rangeCount)
+        : params(params), total(count), first(first), count(rangeCount) {
+        setup();
+        const Random root(params.seed);
+        for (size_t chunk = first / ChunkSize; chunk * ChunkSize < first + rangeCount; chunk++)
+            generateChunk(root, chunk);
+    }
+
+    // sphere around rocks [first, last) of a belt of 'count' rocks drawn with 'mesh', at time 0,
+    // without generating them: the arc of the sector plus the random displacement and the rock size
+    static BoundingSphere rangeBounds(const AsteroidBeltParams& params, size_t count, size_t first, size_t last, const BoundingSphere& mesh) {
+        float a0 = (float)first / (float)count * glm::two_pi<float>();
+        float a1 = (float)last / (float)count * glm::two_pi<float>();
+        float middle = (a0 + a1) * 0.5f;
+        BoundingSphere sphere;
+        sphere.center = glm::vec3(std::sin(middle) * params.radius, 0.0f, std::cos(middle) * params.radius);
+        float arc = 2.0f * params.radius * std::sin(std::min((a1 - a0) * 0.25f, glm::half_pi<float>()));
+        float displacement = params.offset * std::sqrt(2.0f + params.heightScale * params.heightScale);
+        sphere.radius = arc + displacement + (glm::length(mesh.center) + mesh.radius) * params.maxScale;
+        return sphere;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // Write every rock at 'time' (seconds) as 'format' to out[0 .. size()), in parallel. With a
+    // culler (InstanceCuller, BoundingVolumeHierarchy: anything with setSphere(i, center, radius)),
+    // also store each rock's bounding sphere ('mesh' transformed) for the next cull().
+    template<typename Culler = InstanceCuller>
+    void evaluate(float time, InstanceFormat format, void* out, ThreadPool& pool,
+        Culler* culler = nullptr, const BoundingSphere& mesh = BoundingSphere()) const {
+        size_t stride = instanceStride(format);
+        pool.parallelFor(count, ChunkSize, [&](size_t begin, size_t end) {
+            char* dst = static_cast<char*>(out) + begin * stride;
+            for (size_t i = begin; i < end; i++, dst += stride)
+                evaluateOne(i, time, format, dst, culler, mesh);
+        });
+    }
+
+    // the same on the calling thread, without bounding spheres (for loader threads)
+    void evaluate(float time, InstanceFormat format, void* out) const {
+        size_t stride = instanceStride(format);
+        char* dst = static_cast<char*>(out);
+        for (size_t i = 0; i < count; i++, dst += stride)
+            evaluateOne<InstanceCuller>(i, time, format, dst, nullptr, BoundingSphere());
+    }
+
+private:
+    AsteroidBeltParams params;
+    size_t total;        // rocks in the whole belt
+    size_t first = 0;    // global index of rock 0 here
+    size_t count;        // rocks stored here
+    std::vector<float> x, y, z, scale, spin, orbitSpeed, spinSpeed;
+    glm::vec3 axis;
+    glm::vec4 E[3], A[3], K[3];   // constant parts of the rotation columns: identity, a a^T and [a]x
+
+    void setup() {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        scale.resize(count);
+        spin.resize(count);
+        orbitSpeed.resize(count);
+        spinSpeed.resize(count);
+
+        axis = glm::normalize(params.rotationAxis);
+        E[0] = glm::vec4(1, 0, 0, 0);
+        E[1] = glm::vec4(0, 1, 0, 0);
+        E[2] = glm::vec4(0, 0, 1, 0);
+        A[0] = glm::vec4(axis * axis.x, 0.0f);
+        A[1] = glm::vec4(axis * axis.y, 0.0f);
+        A[2] = glm::vec4(axis * axis.z, 0.0f);
+        K[0] = glm::vec4(0.0f, axis.z, -axis.y, 0.0f);
+        K[1] = glm::vec4(-axis.z, 0.0f, axis.x, 0.0f);
+        K[2] = glm::vec4(axis.y, -axis.x, 0.0f, 0.0f);
+    }
+
+    // global chunk 'chunk' (rocks chunk * ChunkSize ..), only the part stored here
+    void generateChunk(const Random& root, size_t chunk) {
+        Random random = root.split(chunk);
+        size_t begin = chunk * ChunkSize;
+        size_t end = begin + ChunkSize < total ? begin + ChunkSize : total;
+        for (size_t g = begin; g < end; g++) {
+            // every rock draws the same numbers whether it is stored or not, so the stream stays in step
+            float dx = random.uniform(-params.offset, params.offset);
+            float dy = random.uniform(-params.offset, params.offset);
+            float dz = random.uniform(-params.offset, params.offset);
+            float rockScale = random.uniform(params.minScale, params.maxScale);
+            float rockSpin = random.uniform(0.0f, glm::two_pi<float>());
+            float rockSpinSpeed = random.uniform(-params.maxSpinSpeed, params.maxSpinSpeed);
+            if (g < first || g >= first + count)
+                continue;
+            size_t i = g - first;
+            // 1. translation: displace along circle with 'radius' in range [-offset, offset]
+            float angle = (float)g / (float)total * glm::two_pi<float>();
+            x[i] = std::sin(angle) * params.radius + dx;
+            y[i] = dy * params.heightScale;
+            z[i] = std::cos(angle) * params.radius + dz;
+            // 2. scale
+            scale[i] = rockScale;
+            // 3. rotation around the fixed axis
+            spin[i] = rockSpin;
+            // 4. motion
+            float r = std::sqrt(x[i] * x[i] + z[i] * z[i]);
+            orbitSpeed[i] = params.orbitSpeed * std::pow(params.radius / r, 1.5f);
+            spinSpeed[i] = rockSpinSpeed;
+        }
+    }
+
+    template<typename Culler>
+    void evaluateOne(size_t i, float time, InstanceFormat format, char* dst, Culler* culler, const BoundingSphere& mesh) const {
+        // orbit: rotate the start position around the y axis
+        float orbit = orbitSpeed[i] * time;
+        float co = std::cos(orbit), so = std::sin(orbit);
+        glm::vec3 position(x[i] * co + z[i] * so, y[i], z[i] * co - x[i] * so);
+        float s = scale[i];
+        float angle = spin[i] + spinSpeed[i] * time;
+
+        glm::vec4 columns[3];
+        if (format == InstanceFormat::Matrix || culler != nullptr) {
+            float c = std::cos(angle), sn = std::sin(angle);
+#ifdef INSTANCE_GENERATOR_SSE
+            __m128 cosScale = _mm_set1_ps(c * s);
+            __m128 oneMinusCosScale = _mm_set1_ps((1.0f - c) * s);
+            __m128 sinScale = _mm_set1_ps(sn * s);
+            for (int col = 0; col < 3; col++) {
+                __m128 column = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cosScale, _mm_loadu_ps(&E[col].x)),
+                    _mm_mul_ps(oneMinusCosScale, _mm_loadu_ps(&A[col].x))), _mm_mul_ps(sinScale, _mm_loadu_ps(&K[col].x)));
+                _mm_storeu_ps(&columns[col].x, column);
+            }
+#else
+            for (int col = 0; col < 3; col++)
+                columns[col] = (E[col] * c + A[col] * (1.0f - c) + K[col] * sn) * s;
+#endif
+        }
+
+        if (culler != nullptr) {
+            glm::vec3 center = position + glm::vec3(columns[0]) * mesh.center.x + glm::vec3(columns[1]) * mesh.center.y + glm::vec3(columns[2]) * mesh.center.z;
+            culler->setSphere(i, center, mesh.radius * s);
+        }
+
+        switch (format) {
+        case InstanceFormat::Matrix: {
+            glm::mat4 m(columns[0], columns[1], columns[2], glm::vec4(position, 1.0f));
+            std::memcpy(dst, &m, sizeof(m));
+            break;
+        }
+        case InstanceFormat::Quat: {
+            float half = angle * 0.5f;
+            InstanceQuat instance = { glm::vec4(position, s), glm::vec4(axis * std::sin(half), std::cos(half)) };
+            std::memcpy(dst, &instance, sizeof(instance));
+            break;
+        }
+        case InstanceFormat::PackedHalf: {
+            float half = angle * 0.5f;
+            glm::vec4 positionScale(position, s);
+            glm::vec4 rotation(axis * std::sin(half), std::cos(half));
+            InstancePackedHalf instance;
+            for (int c = 0; c < 4; c++) {
+                instance.positionScale[c] = glm::packHalf1x16(positionScale[c]);
+                instance.rotation[c] = packSnorm16(rotation[c]);
+            }
+            std::memcpy(dst, &instance, sizeof(instance));
+            break;
+        }
+        }
+    }
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Per-frame level of detail for the instances that survived culling: each one is put in one of
+// three tiers by the size of its bounding sphere on screen.
+//
+//  Mesh      the full model
+//  Impostor  below impostorPixels: one camera-facing quad textured from an octahedral atlas
+//            (impostor.h)
+//  Point     below pointPixels: one GL_POINTS vertex whose gl_PointSize is the projected size
+//
+// The projected diameter of a sphere of radius r at distance d is about 2 r pixelScale / d, with
+// pixelScale = projection[1][1] * viewport height / 2 (pixels per unit at distance 1). It is
+// compared squared, so no square root per instance.
+//
+// classify() works like the culler: chunks of the visible list are binned on the ThreadPool,
+// every chunk counts its tiers, a prefix sum over the chunk counts gives each chunk its place in
+// the per-tier lists, and a second pass writes the indices there. The lists keep the culler's
+// order.
+//
+//     lod.classify(culler, eye, InstanceLod::pixelScale(projection, height), pool);
+//     lod.write(InstanceLod::Impostor, instances, stride, out, pool);   // room for count(Impostor)
+class InstanceLod {
+public:
+    enum Tier {
+        Mesh,
+        Impostor,
+        Point,
+        TierCount
+    };
+
+    struct Stats {
+        size_t count[TierCount] = {};
+        double classifyMs = 0.0;   // classify() + write() of the last frame
+    };
+
+    explicit InstanceLod(float impostorPixels = 24.0f, float pointPixels = 4.0f) {
+        setThresholds(impostorPixels, pointPixels);
+    }
+
+    // projected diameters (in pixels) below which an instance becomes an impostor / a point
+    void setThresholds(float impostorPixels, float pointPixels) {
+        impostorBelow = impostorPixels;
+        pointBelow = std::min(pointPixels, impostorPixels);
+    }
+
+    float impostorPixels() const {
+        return impostorBelow;
+    }
+
+    float pointPixels() const {
+        return pointBelow;
+    }
+
+    static float pixelScale(const glm::mat4& projection, int viewportHeight) {
+        return projection[1][1] * viewportHeight * 0.5f;
+    }
+
+    // bin the visible instances of 'culler' (an InstanceCuller or a BoundingVolumeHierarchy, after cull())
+    template<typename Culler>
+    void classify(const Culler& culler, const glm::vec3& eye, float pixelScale, ThreadPool& pool) {
+        auto start = std::chrono::steady_clock::now();
+        const std::vector<uint32_t>& visible = culler.visibleIndices();
+        size_t chunks = (visible.size() + ChunkSize - 1) / ChunkSize;
+        tiers.resize(visible.size());
+        chunkCount.assign(chunks * TierCount, 0);
+
+        // (2 r pixelScale)^2 < (pixels d)^2
+        float impostor2 = impostorBelow * impostorBelow;
+        float point2 = pointBelow * pointBelow;
+        float scale2 = 4.0f * pixelScale * pixelScale;
+        pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                size_t* count = &chunkCount[chunk * TierCount];
+                size_t last = std::min((chunk + 1) * ChunkSize, visible.size());
+                for (size_t i = chunk * ChunkSize; i < last; i++) {
+                    glm::vec4 s = culler.sphere(visible[i]);
+                    glm::vec3 toEye = glm::vec3(s) - eye;
+                    float distance2 = glm::dot(toEye, toEye);
+                    float size2 = s.w * s.w * scale2;
+                    uint8_t tier = size2 >= impostor2 * distance2 ? Mesh : size2 >= point2 * distance2 ? Impostor : Point;
+                    tiers[i] = tier;
+                    count[tier]++;
+                }
+            }
+        });
+
+        // exclusive prefix sum per tier; chunkCount becomes the chunk's first slot in each list
+        for (int tier = 0; tier < TierCount; tier++) {
+            size_t total = 0;
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                size_t n = chunkCount[chunk * TierCount + tier];
+                chunkCount[chunk * TierCount + tier] = total;
+                total += n;
+            }
+            lists[tier].resize(total);
+            lastStats.count[tier] = total;
+        }
+
+        pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                size_t next[TierCount];
+                for (int tier = 0; tier < TierCount; tier++)
+                    next[tier] = chunkCount[chunk * TierCount + tier];
+                size_t last = std::min((chunk + 1) * ChunkSize, visible.size());
+                for (size_t i = chunk * ChunkSize; i < last; i++)
+                    lists[tiers[i]][next[tiers[i]]++] = visible[i];
+            }
+        });
+        lastStats.classifyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t count(Tier tier) const {
+        return lists[tier].size();
+    }
+
+    const std::vector<uint32_t>& indices(Tier tier) const {
+        return lists[tier];
+    }
+
+    // copy the instance data of one tier to out[0 .. count(tier)): 'stride' bytes per instance in 'instances' and in 'out'
+    void write(Tier tier, const void* instances, size_t stride, void* out, ThreadPool& pool) {
+        auto start = std::chrono::steady_clock::now();
+        const std::vector<uint32_t>& list = lists[tier];
+        const char* src = static_cast<const char*>(instances);
+        char* dst = static_cast<char*>(out);
+        pool.parallelFor(list.size(), ChunkSize, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                std::memcpy(dst + i * stride, src + list[i] * stride, stride);
+        });
+        lastStats.classifyMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const Stats& stats() const {
+        return lastStats;
+    }
+
+private:
+    static const size_t ChunkSize = 1024;
+
+    float impostorBelow = 24.0f;
+    float pointBelow = 4.0f;
+    std::vector<uint8_t> tiers;          // tier of every visible instance
+    std::vector<size_t> chunkCount;      // TierCount counters per chunk, then their prefix sums
+    std::vector<uint32_t> lists[TierCount];
+    Stats lastStats;
+};
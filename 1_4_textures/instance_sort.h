@@ -0,0 +1,195 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Front-to-back order for instanced draws, so early depth testing rejects the fragments of rocks
+// hidden behind nearer ones instead of shading them first and overwriting them later.
+//
+// Every instance gets a 16-bit key: the view depth of its bounding sphere center, quantized over
+// the depth range of this frame's instances. Key and instance index are packed into one 64-bit
+// item and sorted with a parallel LSD radix sort (8-bit digits): every chunk counts its digits on
+// the ThreadPool, a prefix sum over (digit, chunk) gives every chunk its place per digit, and the
+// chunks scatter in parallel; the sort is stable, so equal keys keep the culler's order.
+//  Radix    two passes, full 16-bit order (about 1/65536 of the depth range)
+//  Buckets  one pass on the high byte: 256 depth buckets, unordered inside a bucket, half the cost
+//
+//     sort.sort(culler.visibleIndices(), culler, eye, forward, pool);   // any list with culler.sphere(i)
+//     sort.write(instances, stride, out, pool);                         // out: room for the list
+class InstanceDepthSort {
+public:
+    enum class Mode {
+        Off,
+        Buckets,
+        Radix,
+    };
+
+    struct Stats {
+        size_t sorted = 0;
+        double sortMs = 0.0;   // sort() + write() of the last frame
+    };
+
+    static const char* modeName(Mode mode) {
+        switch (mode) {
+        case Mode::Buckets: return "buckets";
+        case Mode::Radix: return "radix";
+        default: return "off";
+        }
+    }
+
+    // "off", "buckets" or "radix"; false for anything else
+    static bool parseMode(const std::string& name, Mode& mode) {
+        if (name == "off")
+            mode = Mode::Off;
+        else if (name == "buckets")
+            mode = Mode::Buckets;
+        else if (name == "radix")
+            mode = Mode::Radix;
+        else
+            return false;
+        return true;
+    }
+
+    explicit InstanceDepthSort(Mode mode = Mode::Radix) : sortMode(mode) {
+    }
+
+    Mode mode() const {
+        return sortMode;
+    }
+
+    void setMode(Mode mode) {
+        sortMode = mode;
+    }
+
+    // order 'indices' by the view depth of culler.sphere(index) (Mode::Off keeps their order)
+    template<typename Culler>
+    void sort(const std::vector<uint32_t>& indices, const Culler& culler, const glm::vec3& eye, const glm::vec3& forward, ThreadPool& pool) {
+        auto start = std::chrono::steady_clock::now();
+        size_t n = indices.size();
+        size_t chunks = (n + ChunkSize - 1) / ChunkSize;
+        order.resize(n);
+        if (sortMode == Mode::Off || n < 2) {
+            std::copy(indices.begin(), indices.end(), order.begin());
+            finish(start, n);
+            return;
+        }
+
+        // 1. view depths and their range
+        depth.resize(n);
+        chunkMin.assign(chunks, 0.0f);
+        chunkMax.assign(chunks, 0.0f);
+        pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                float lo = 1e30f, hi = -1e30f;
+                for (size_t i = chunk * ChunkSize; i < std::min(n, (chunk + 1) * ChunkSize); i++) {
+                    float d = glm::dot(glm::vec3(culler.sphere(indices[i])) - eye, forward);
+                    depth[i] = d;
+                    lo = std::min(lo, d);
+                    hi = std::max(hi, d);
+                }
+                chunkMin[chunk] = lo;
+                chunkMax[chunk] = hi;
+            }
+        });
+        float lo = *std::min_element(chunkMin.begin(), chunkMin.end());
+        float hi = *std::max_element(chunkMax.begin(), chunkMax.end());
+        float scale = hi > lo ? 65535.0f / (hi - lo) : 0.0f;
+
+        // 2. items: key in bits 32-47, instance index in bits 0-31
+        items.resize(n);
+        scratch.resize(n);
+        pool.parallelFor(n, ChunkSize, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                uint64_t key = (uint64_t)((depth[i] - lo) * scale + 0.5f);
+                items[i] = (std::min<uint64_t>(key, 65535) << 32) | indices[i];
+            }
+        });
+
+        // 3. radix passes: low byte then high byte, or only the high byte for buckets
+        if (sortMode == Mode::Radix)
+            radixPass(32, chunks, pool);
+        radixPass(40, chunks, pool);
+
+        pool.parallelFor(n, ChunkSize, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                order[i] = (uint32_t)items[i];
+        });
+        finish(start, n);
+    }
+
+    // instance indices, nearest first
+    const std::vector<uint32_t>& sorted() const {
+        return order;
+    }
+
+    // copy the instance data in sorted order to out[0 .. sorted().size()): 'stride' bytes per instance in 'instances' and in 'out'
+    void write(const void* instances, size_t stride, void* out, ThreadPool& pool) {
+        auto start = std::chrono::steady_clock::now();
+        const char* src = static_cast<const char*>(instances);
+        char* dst = static_cast<char*>(out);
+        pool.parallelFor(order.size(), ChunkSize, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                std::memcpy(dst + i * stride, src + order[i] * stride, stride);
+        });
+        lastStats.sortMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const Stats& stats() const {
+        return lastStats;
+    }
+
+private:
+    static const size_t ChunkSize = 16384;
+    static const size_t Digits = 256;
+
+    Mode sortMode;
+    std::vector<uint32_t> order;
+    std::vector<float> depth;
+    std::vector<float> chunkMin, chunkMax;
+    std::vector<uint64_t> items, scratch;
+    std::vector<size_t> offsets;   // Digits counters per chunk, then their scatter positions
+    Stats lastStats;
+
+    // stable counting sort of 'items' by the byte at 'shift'
+    void radixPass(int shift, size_t chunks, ThreadPool& pool) {
+        size_t n = items.size();
+        offsets.assign(chunks * Digits, 0);
+        pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                size_t* count = &offsets[chunk * Digits];
+                for (size_t i = chunk * ChunkSize; i < std::min(n, (chunk + 1) * ChunkSize); i++)
+                    count[(items[i] >> shift) & 0xff]++;
+            }
+        });
+
+        // digit-major exclusive prefix sum: all of digit 0 (chunk 0, chunk 1, ...), then digit 1, ...
+        size_t total = 0;
+        for (size_t digit = 0; digit < Digits; digit++)
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                size_t count = offsets[chunk * Digits + digit];
+                offsets[chunk * Digits + digit] = total;
+                total += count;
+            }
+
+        pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                size_t* next = &offsets[chunk * Digits];
+                for (size_t i = chunk * ChunkSize; i < std::min(n, (chunk + 1) * ChunkSize); i++)
+                    scratch[next[(items[i] >> shift) & 0xff]++] = items[i];
+            }
+        });
+        items.swap(scratch);
+    }
+
+    void finish(std::chrono::steady_clock::time_point start, size_t n) {
+        lastStats.sorted = n;
+        lastStats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
@@ -0,0 +1,302 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "instance_format.h"
+#include "instance_generator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// how a streamed belt is cut up and paged in
+struct InstanceStreamSettings {
+    size_t chunkInstances = 16 * AsteroidBelt::ChunkSize;   // 65536, rounded down to whole generator chunks
+    size_t slots = 32;              // chunks resident on the GPU
+    size_t uploadsPerFrame = 2;
+    unsigned int loaderThreads = 2;
+};
+
+// Asteroid belts too large to keep in memory, streamed in spatial chunks.
+//
+// The belt is cut into chunks of consecutive rocks, and consecutive rocks are sectors of the belt,
+// so every chunk has a bounding sphere known before it is generated (AsteroidBelt::rangeBounds).
+// One GL buffer holds a fixed number of chunk slots. Every update():
+//  1. the chunks nearest to the camera (as many as there are slots) are the wanted set;
+//  2. wanted chunks that are neither resident nor loading are queued, nearest first, for the
+//     loader threads, which generate them (AsteroidBelt range constructor) into CPU memory;
+//  3. at most uploadsPerFrame loaded chunks go into a free slot, or into the slot of the farthest
+//     resident chunk that is no longer wanted, with glBufferSubData;
+//  4. resident chunks in the frustum become this frame's draws, front to back.
+// Nothing in update() waits for a loader, and the upload per frame is bounded, so flying through
+// the belt costs the same every frame; chunks that are not in yet are simply missing for a few
+// frames, at the far edge of the resident set.
+//
+//     InstanceStream stream(params, 10000000, format, rockSphere);
+//     stream.update(eye, frustum);                            // every frame, on the GL thread
+//     for (const InstanceStream::Draw& draw : stream.draws())
+//         ...  // instances at draw.offset in stream.buffer(), draw.count of them
+class InstanceStream {
+public:
+
+    struct Draw {
+        GLintptr offset;   // bytes into buffer()
+        size_t count;
+        float distance;    // from the eye to the chunk's bounding sphere (0 inside)
+        float radius;      // of the chunk's bounding sphere
+    };
+
+    struct Stats {
+        size_t resident = 0;       // chunks in GPU slots
+        size_t loading = 0;        // queued or being generated
+        size_t uploads = 0;        // since the last resetStats()
+        size_t evictions = 0;
+        size_t dropped = 0;        // loaded but no longer wanted when their turn to upload came
+        double uploadMs = 0.0;
+        double loadMs = 0.0;       // loader thread time
+    };
+
+    InstanceStream(const AsteroidBeltParams& params, size_t count, InstanceFormat format, const BoundingSphere& mesh, const InstanceStreamSettings& settings = InstanceStreamSettings())
+        : params(params), total(count), format(format), settings(settings) {
+        this->settings.chunkInstances = std::max<size_t>(1, settings.chunkInstances / AsteroidBelt::ChunkSize) * AsteroidBelt::ChunkSize;
+        size_t chunkCount = (count + this->settings.chunkInstances - 1) / this->settings.chunkInstances;
+        this->settings.slots = std::min(std::max<size_t>(settings.slots, 1), chunkCount);
+        slotBytes = this->settings.chunkInstances * instanceStride(format);
+
+        chunks.resize(chunkCount);
+        for (size_t c = 0; c < chunkCount; c++) {
+            chunks[c].first = c * this->settings.chunkInstances;
+            chunks[c].count = std::min(this->settings.chunkInstances, count - chunks[c].first);
+            chunks[c].bounds = AsteroidBelt::rangeBounds(params, count, chunks[c].first, chunks[c].first + chunks[c].count, mesh);
+        }
+        for (size_t slot = 0; slot < this->settings.slots; slot++)
+            freeSlots.push_back(this->settings.slots - 1 - slot);
+
+        glGenBuffers(1, &gpuBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, gpuBuffer);
+        glBufferData(GL_ARRAY_BUFFER, this->settings.slots * slotBytes, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        for (unsigned int i = 0; i < std::max(1u, settings.loaderThreads); i++)
+            loaders.emplace_back(&InstanceStream::loaderLoop, this);
+    }
+
+    ~InstanceStream() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& loader : loaders)
+            loader.join();
+        glDeleteBuffers(1, &gpuBuffer);
+    }
+
+    InstanceStream(const InstanceStream&) = delete;
+    InstanceStream& operator=(const InstanceStream&) = delete;
+
+    // on the GL thread, once per frame before drawing
+    void update(const glm::vec3& eye, const Frustum& frustum) {
+        for (Chunk& chunk : chunks)
+            chunk.distance = std::max(0.0f, glm::length(chunk.bounds.center - eye) - chunk.bounds.radius);
+        byDistance.resize(chunks.size());
+        for (size_t c = 0; c < chunks.size(); c++)
+            byDistance[c] = c;
+        std::sort(byDistance.begin(), byDistance.end(), [this](size_t a, size_t b) { return chunks[a].distance < chunks[b].distance; });
+        for (size_t i = 0; i < byDistance.size(); i++)
+            chunks[byDistance[i]].wanted = i < settings.slots;
+
+        std::vector<Loaded> arrived;
+        bool pending = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t c : taken)
+                chunks[c].state = Loading;
+            taken.clear();
+            // queue the wanted chunks nearest first; a queued chunk that is no longer wanted is dropped
+            queue.clear();
+            for (size_t i = 0; i < settings.slots; i++) {
+                Chunk& chunk = chunks[byDistance[i]];
+                if (chunk.state == Unloaded || chunk.state == Queued) {
+                    chunk.state = Queued;
+                    queue.push_back(byDistance[i]);
+                }
+            }
+            for (Chunk& chunk : chunks)
+                if (chunk.state == Queued && !chunk.wanted)
+                    chunk.state = Unloaded;
+            // uploads: the nearest loaded chunks first
+            std::sort(loaded.begin(), loaded.end(), [this](const Loaded& a, const Loaded& b) { return chunks[a.chunk].distance < chunks[b.chunk].distance; });
+            size_t n = std::min(loaded.size(), settings.uploadsPerFrame);
+            arrived.assign(std::make_move_iterator(loaded.begin()), std::make_move_iterator(loaded.begin() + n));
+            loaded.erase(loaded.begin(), loaded.begin() + n);
+            pending = !queue.empty();
+            lastStats.loading = queue.size() + generating + loaded.size();
+            lastStats.loadMs += loadMs;
+            loadMs = 0.0;
+        }
+        if (pending)
+            wake.notify_all();
+
+        auto uploadStart = std::chrono::steady_clock::now();
+        for (Loaded& item : arrived) {
+            Chunk& chunk = chunks[item.chunk];
+            if (!chunk.wanted) {
+                chunk.state = Unloaded;
+                lastStats.dropped++;
+                continue;
+            }
+            size_t slot = takeSlot();
+            glBindBuffer(GL_ARRAY_BUFFER, gpuBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, slot * slotBytes, item.data.size(), item.data.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            chunk.slot = slot;
+            chunk.state = Resident;
+            lastStats.uploads++;
+        }
+        lastStats.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+
+        visible.clear();
+        lastStats.resident = 0;
+        for (size_t c : byDistance) {
+            const Chunk& chunk = chunks[c];
+            if (chunk.state != Resident)
+                continue;
+            lastStats.resident++;
+            if (frustum.intersectsSphere(chunk.bounds.center, chunk.bounds.radius)) {
+                Draw draw = { (GLintptr)(chunk.slot * slotBytes), chunk.count, chunk.distance, chunk.bounds.radius };
+                visible.push_back(draw);
+            }
+        }
+    }
+
+    // resident chunks in the frustum, nearest first
+    const std::vector<Draw>& draws() const {
+        return visible;
+    }
+
+    GLuint buffer() const {
+        return gpuBuffer;
+    }
+
+    size_t chunkCount() const {
+        return chunks.size();
+    }
+
+    const InstanceStreamSettings& config() const {
+        return settings;
+    }
+
+    // GPU memory of the slots, in bytes
+    size_t residentBytes() const {
+        return settings.slots * slotBytes;
+    }
+
+    const Stats& stats() const {
+        return lastStats;
+    }
+
+    // zero the counters that add up (uploads, evictions, dropped, upload and load time)
+    void resetStats() {
+        lastStats.uploads = lastStats.evictions = lastStats.dropped = 0;
+        lastStats.uploadMs = lastStats.loadMs = 0.0;
+    }
+
+private:
+    enum State {
+        Unloaded,
+        Queued,     // waiting for a loader
+        Loading,    // being generated, or generated and waiting for upload
+        Resident,
+    };
+
+    struct Chunk {
+        size_t first = 0;
+        size_t count = 0;
+        BoundingSphere bounds;
+        float distance = 0.0f;
+        bool wanted = false;
+        State state = Unloaded;   // main thread only: the loaders report through 'taken' and 'loaded'
+        size_t slot = 0;
+    };
+
+    struct Loaded {
+        size_t chunk;
+        std::vector<char> data;
+    };
+
+    AsteroidBeltParams params;
+    size_t total;
+    InstanceFormat format;
+    InstanceStreamSettings settings;
+    size_t slotBytes = 0;
+    std::vector<Chunk> chunks;
+    std::vector<size_t> byDistance;
+    std::vector<size_t> freeSlots;
+    std::vector<Draw> visible;
+    GLuint gpuBuffer = 0;
+    Stats lastStats;
+
+    // shared with the loaders
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<size_t> queue;
+    std::vector<size_t> taken;     // chunks the loaders picked from the queue since the last update()
+    std::vector<Loaded> loaded;
+    size_t generating = 0;
+    double loadMs = 0.0;
+    bool stopping = false;
+    std::vector<std::thread> loaders;
+
+    // a free slot, or the one of the farthest resident chunk that is not wanted any more (there is
+    // always one: at most 'slots' chunks are wanted, and one of them is waiting for this slot)
+    size_t takeSlot() {
+        if (!freeSlots.empty()) {
+            size_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        for (auto it = byDistance.rbegin(); it != byDistance.rend(); ++it) {
+            Chunk& chunk = chunks[*it];
+            if (chunk.state == Resident && !chunk.wanted) {
+                chunk.state = Unloaded;
+                lastStats.evictions++;
+                return chunk.slot;
+            }
+        }
+        return 0; // not reached
+    }
+
+    void loaderLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping)
+                return;
+            size_t c = queue.front();
+            queue.pop_front();
+            taken.push_back(c);
+            size_t first = chunks[c].first, count = chunks[c].count;
+            generating++;
+            lock.unlock();
+
+            auto start = std::chrono::steady_clock::now();
+            Loaded item;
+            item.chunk = c;
+            item.data.resize(count * instanceStride(format));
+            AsteroidBelt(params, total, first, count).evaluate(0.0f, format, item.data.data());
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            lock.lock();
+            generating--;
+            loadMs += ms;
+            loaded.push_back(std::move(item));
+        }
+    }
+};
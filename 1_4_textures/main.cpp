@@ -2,7 +2,32 @@
 #include <GLFW/glfw3.h>
 
 #include "shader_s.h"
+#include "shader_compile_queue.h"
+#include "shader_variant_cache.h"
 #include "camera.h"
+#include "frustum.h"
+#include "instance_culling.h"
+#include "gpu_instance_culling.h"
+#include "bvh.h"
+#include "occlusion_buffer.h"
+#include "instance_lod.h"
+#include "instance_sort.h"
+#include "impostor.h"
+#include "frame_ring_buffer.h"
+#include "thread_pool.h"
+#include "camera_path.h"
+#include "gpu_timer.h"
+#include "frame_timing_log.h"
+#include "input_queue.h"
+#include "camera_simulation.h"
+#include "instance_generator.h"
+#include "instance_format.h"
+#include "instance_streaming.h"
+#include "render_target_pool.h"
+#include "post_process.h"
+#include "blur_filters.h"
+#include "quality_governor.h"
+#include "anti_aliasing.h"
 
 #include "model.h"
 #include "mesh.h"
@@ -12,10 +37,15 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow* window);
 
 unsigned int loadTexture(char const* path);
@@ -24,29 +54,108 @@ unsigned int loadCubemap(vector<std::string> faces);
 // settings
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
+// 帧缓冲的实际大小（窗口大小改变时由回调更新），渲染目标池在每帧开始时跟上
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
-// 全局变量2：用于相机系统
+// 全局变量2：用于相机系统（渲染用的相机，每帧由模拟状态插值得到）
 Camera camera(glm::vec3(50.0f, 10.0f, 50.0f));
 
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
-
-bool firstMouse = true;
-float lastX = SCR_WIDTH / 2.0f;
-float lastY = SCR_HEIGHT / 2.0f;
+// GLFW回调只把带时间戳的输入事件放进队列，由固定步长的模拟去处理
+InputQueue inputQueue;
 
 // lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
-int main()
+// 基准测试：相机路径录制/回放（回放时用固定的模拟时间步长，鼠标键盘不再控制相机）
+//   --record <file>               记录实时操控的相机
+//   --replay <file>               回放录制的路径
+//   --path orbit|belt|planet      回放内置路径
+//   --dt <seconds>                回放时每帧推进的模拟时间（默认1/60）
+//   --timings <file.csv>          每帧CPU/GPU耗时（回放时默认写 frame_timings.csv）
+//   --rocks <count>               小行星数量（默认9000）
+//   --seed <n>                    小行星带的随机种子（默认1）
+//   --instance-format matrix|quat|half   每个实例的数据格式（64/32/16字节，默认matrix）
+//   --animate                     小行星公转和自转，每帧更新全部实例
+//   --no-cull                     不做视锥剔除，每帧上传全部实例
+//   --gpu-cull                    视锥剔除放到GPU上（transform feedback），实例数据不经过CPU
+//   --bvh-cull                    用层次包围盒（BVH）做视锥剔除，整块在视锥内/外的小行星不再逐个测试
+//   --occlusion                   CPU/BVH剔除时再做遮挡剔除：被行星挡住的小行星不提交
+//   --lod                         CPU/BVH剔除后按屏幕大小分档：近处画网格，远处画八面体impostor，更远只画一个点
+//   --stream                      小行星带按扇区分块，后台线程只生成相机附近的块，放进固定大小的GPU实例池（千万级，配合 --rocks）
+//   --sort off|buckets|radix      CPU/BVH剔除后把要画网格的小行星按视深由近到远排序（基数排序或256个深度桶），并统计小行星网格写了多少个采样（off是不排序的对照）
+//   --target-format rgba8|rgb10a2|r11g11b10f|rgba16f   离屏渲染目标（MSAA场景和解析结果）的颜色格式（默认rgba8）
+//   --post <effect,...>           后处理链，从 invert、grayscale（逐像素）、sharpen、edge、blur（3x3邻域）和 gaussian、kawase（大半径模糊）中选，按顺序执行（默认grayscale，none为直接输出）
+//   --governor <ms>               动态分辨率/画质调节：按CPU/GPU帧时间逐级调整渲染分辨率、MSAA采样数和LOD偏置，保持目标帧时间（如16.7）
+//   --governor-log <file.csv>     调节器的每一次决定（帧、帧时间、档位、原因）
+//   --aa off|msaa|fxaa|taa        抗锯齿方式（默认msaa）：多重采样、FXAA后处理、或抖动投影+历史帧重投影的TAA；运行时按F键切换，每秒打印这种方式的GPU耗时
+//   --blur-sigma <px>             gaussian/kawase 的模糊半径（1080p下的高斯sigma，像素，默认8；按实际分辨率缩放）
+// 小行星的视锥剔除在哪里做
+enum class RockCulling {
+    None,
+    Cpu,
+    Gpu,
+    Bvh,
+};
+
+struct BenchmarkOptions {
+    std::string recordPath;
+    std::string replayPath;
+    std::string builtinPath;
+    std::string timingsPath;
+    float fixedStep = 1.0f / 60.0f;
+    unsigned int rocks = 9000;
+    unsigned long long seed = 1;
+    InstanceFormat instanceFormat = InstanceFormat::Matrix;
+    bool animate = false;
+    RockCulling culling = RockCulling::Cpu;
+    bool occlusion = false;
+    bool lod = false;
+    bool stream = false;
+    InstanceDepthSort::Mode sort = InstanceDepthSort::Mode::Off;
+    bool overdraw = false;          // --sort 给了就统计小行星网格的采样数
+    GLenum targetFormat = GL_RGBA8;
+    std::string postEffects = "grayscale";
+    float blurSigma = 8.0f;
+    double governorMs = 0.0;        // 0 = 固定画质
+    std::string governorLogPath;
+    AntiAliasingMode antiAliasing = AntiAliasingMode::Msaa;
+
+    bool playback() const {
+        return !replayPath.empty() || !builtinPath.empty();
+    }
+};
+
+BenchmarkOptions parseBenchmarkOptions(int argc, char** argv);
+
+bool cameraPlayback = false;
+
+// 每帧都要设置的uniform：名字在编译期哈希，渲染循环里不再构造std::string也不再调用glGetUniformLocation
+namespace uniforms {
+    constexpr UniformID projection("projection");
+    constexpr UniformID view("view");
+    constexpr UniformID model("model");
+}
+
+int main(int argc, char** argv)
 {
+    BenchmarkOptions benchmark = parseBenchmarkOptions(argc, argv);
+    CameraPath cameraPath;
+    if (!benchmark.replayPath.empty() && !cameraPath.load(benchmark.replayPath))
+        return -1;
+    if (!benchmark.builtinPath.empty() && (cameraPath = CameraPath::builtin(benchmark.builtinPath)).keys.empty())
+        return -1;
+    cameraPlayback = benchmark.playback();
+    if (cameraPlayback && benchmark.timingsPath.empty())
+        benchmark.timingsPath = "frame_timings.csv";
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 4);
+    glfwWindowHint(GLFW_SAMPLES, 0); // 场景画在离屏目标里，默认帧缓冲不需要多重采样（MSAA直接解析进它时也要求它是单采样的）
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -66,6 +175,9 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
+
+    camera.SetProjection((float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 500.0f);
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -85,81 +197,196 @@ int main()
 
     // build and compile our shader program
     // ------------------------------------
-    
-    Shader antiAliasingShader("./shaders/4_11_AntiAliasing/antiAliasingShader.vs", "./shaders/4_11_AntiAliasing/antiAliasingShader.fs");
-    Shader antiAliasingShader2("./shaders/4_11_AntiAliasing/antiAliasingShader2.vs", "./shaders/4_11_AntiAliasing/antiAliasingShader.fs");
-    Shader antiAliasingPostShader("./shaders/4_11_AntiAliasing/antiAliasingPostShader.vs", "./shaders/4_11_AntiAliasing/antiAliasingPostShader.fs");
+    auto shaderStart = std::chrono::steady_clock::now();
+
+    // 只提交编译和链接，不查询状态：驱动可以并行编译（GL_KHR_parallel_shader_compile），同时CPU去加载模型
+    ShaderCompileQueue shaderQueue;
+    // 同一份源码的不同宏组合（变体）只在第一次用到时编译一次
+    ShaderVariantCache shaderVariants(shaderQueue);
+    Shader& antiAliasingShader = shaderVariants.get("./shaders/4_11_AntiAliasing/antiAliasingShader.vs", "./shaders/4_11_AntiAliasing/antiAliasingShader.fs");
+    ShaderDefines rockDefines = { { "INSTANCED", "1" } };
+    if (benchmark.instanceFormat != InstanceFormat::Matrix)
+        rockDefines["INSTANCE_QUAT"] = "1"; // 紧凑实例格式：在顶点着色器里由四元数重建model矩阵
+    Shader& antiAliasingShader2 = shaderVariants.get("./shaders/4_11_AntiAliasing/antiAliasingShader.vs", "./shaders/4_11_AntiAliasing/antiAliasingShader.fs", rockDefines);
+    // 后处理链：逐像素效果并进相邻的pass，每个pass的片元着色器按效果列表生成，全屏pass数 = max(1, 邻域效果数)
+    //    大半径模糊自己跑多个pass：可分离高斯（线性采样，sigma大时降分辨率）和dual-Kawase（逐级降采样再升采样）
+    GaussianBlur gaussianBlur(shaderQueue, "./shaders/4_11_AntiAliasing/antiAliasingPostShader.vs", benchmark.blurSigma);
+    DualKawaseBlur kawaseBlur(shaderQueue, "./shaders/4_11_AntiAliasing/antiAliasingPostShader.vs", benchmark.blurSigma);
+    std::vector<PostEffect> postFilters = { gaussianBlur.effect(), kawaseBlur.effect(), fxaaEffect() };
+    std::vector<PostEffect> postEffects;
+    std::string unknownEffect;
+    if (!PostEffect::parseList(benchmark.postEffects, postEffects, unknownEffect, postFilters)) {
+        std::cout << "Unknown post effect " << unknownEffect << " (invert, grayscale, sharpen, edge, blur, gaussian, kawase, fxaa), using grayscale" << std::endl;
+        PostEffect::parseList("grayscale", postEffects, unknownEffect);
+    }
+    PostProcessChain postChain(shaderQueue, postEffects, "./shaders/4_11_AntiAliasing/antiAliasingPostShader.vs");
+    // 抗锯齿：FXAA接在后处理链的最前面（和它后面的逐像素效果共用一个pass）；TAA在后处理之前把这一帧混进历史帧
+    std::vector<PostEffect> fxaaEffects = postEffects;
+    fxaaEffects.insert(fxaaEffects.begin(), fxaaEffect());
+    PostProcessChain fxaaPostChain(shaderQueue, fxaaEffects, "./shaders/4_11_AntiAliasing/antiAliasingPostShader.vs");
+    TemporalAA temporalAA(shaderQueue, "./shaders/4_11_AntiAliasing/antiAliasingPostShader.vs");
+
+    double shaderIssueMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count();
 
     // load models
     Model rock("C:/hqh/code/learnopengl_resources/rock/rock.obj");
     Model planet("C:/hqh/code/learnopengl_resources/planet/planet.obj");
 
-    // -> generate a large list of semi-random model transformation matrices
-    auto generate_model_matrices = [&](unsigned int amount) -> glm::mat4* {
-        glm::mat4* modelMatrices = new glm::mat4[amount];
+    auto shaderWaitStart = std::chrono::steady_clock::now();
+    shaderQueue.finish();
+
+    // 着色器创建耗时：第一次运行（冷缓存）全部编译，之后（热缓存）直接从 ./shader_cache 读取program binary
+    double shaderWaitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderWaitStart).count();
+    std::cout << "Shader creation: " << shaderIssueMs << " ms issuing + " << shaderWaitMs << " ms waiting for "
+        << shaderQueue.size() << " programs (parallel compile " << (glExtensions().parallelShaderCompile ? "on" : "not supported")
+        << ", program binary cache " << (ProgramBinaryCache::enabled() ? "enabled" : "not supported") << ", "
+        << ProgramBinaryCache::stats().hits << " hits, " << ProgramBinaryCache::stats().misses << " misses)" << std::endl;
+
+    // -> 生成小行星带（每颗的初始位置、缩放、自转角和轨道/自转速度）：固定种子、按块并行生成，每次运行完全相同（基准测试可比）
+    ThreadPool workers;
+    unsigned int amount = benchmark.rocks;
+    AsteroidBeltParams beltParams;
+    beltParams.seed = benchmark.seed;
+    // --stream 时整条带不在内存里，这里什么都不生成，剔除按块做
+    if (benchmark.stream) {
+        if (benchmark.animate || benchmark.culling != RockCulling::Cpu)
+            std::cout << "--stream draws a static belt and culls whole chunks, --animate and the culling options are ignored" << std::endl;
+        benchmark.animate = false;
+        benchmark.culling = RockCulling::None;
+    }
+    unsigned int beltAmount = benchmark.stream ? 0 : amount;
+    auto generateStart = std::chrono::steady_clock::now();
+    AsteroidBelt asteroidBelt(beltParams, beltAmount, workers);
+
+    // -> 实例数据直接按所选格式写出：mat4 64字节，位置+缩放+四元数 32字节，half/snorm16打包 16字节
+    //    同时算出每颗小行星的包围球（岩石模型的包围球经实例变换），供视锥剔除用SIMD在工作线程上测试
+    InstanceFormat rockFormat = benchmark.instanceFormat;
+    size_t rockStride = instanceStride(rockFormat);
+    std::vector<char> rockInstanceData(beltAmount * rockStride);
+    BoundingSphere rockSphere = rock.GetBoundingSphere();
+    InstanceCuller rockCuller;
+    rockCuller.resize(beltAmount);
+    asteroidBelt.evaluate(0.0f, rockFormat, rockInstanceData.data(), workers, &rockCuller, rockSphere);
+    std::cout << "Generated " << beltAmount << " asteroids (seed " << beltParams.seed << ") in "
+        << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - generateStart).count()
+        << " ms on " << workers.size() << " threads" << std::endl;
+    std::cout << "Instance format: " << instanceFormatName(rockFormat) << ", " << rockStride << " bytes/instance, "
+        << (size_t)amount * rockStride / 1024 << " KB for all instances" << std::endl;
+
+    // -> 实例数据每帧写进流式缓冲：GL 4.4上是三份区域、持久映射、用fence保护的环形缓冲，3.3上每帧orphan
+    //    剔除时只写可见实例；--no-cull 时写全部，--animate 时每帧重新计算轨道和自转后直接写进映射的缓冲
+    //    持久映射的存储不能扩容，所以按整条小行星带的大小分配：每帧写进去的实例不会超过它
+    FrameRingBuffer instanceRing(GL_ARRAY_BUFFER, std::max(beltAmount, 1u) * rockStride);
+    static const char* cullingNames[] = { "off", "CPU", "GPU", "BVH" };
+    std::cout << "Asteroid stream: " << (benchmark.animate ? "animated" : "static") << ", culling " << cullingNames[(int)benchmark.culling]
+        << ", " << (instanceRing.isPersistent() ? "persistent mapped ring (3 frames)" : "orphaned buffer") << std::endl;
+
+    // -> 分块流式：每块65536颗（一段扇区），离相机最近的32块常驻在一个GPU缓冲的固定槽位里；
+    //    缺的块由后台线程生成，每帧最多上传两块，所以飞过整条带时每帧的开销不变
+    std::unique_ptr<InstanceStream> rockStream;
+    if (benchmark.stream) {
+        rockStream.reset(new InstanceStream(beltParams, amount, rockFormat, rockSphere));
+        std::cout << "Chunked streaming: " << rockStream->chunkCount() << " chunks of " << rockStream->config().chunkInstances << " asteroids, "
+            << rockStream->config().slots << " resident (" << rockStream->residentBytes() / (1024 * 1024) << " MB GPU pool), "
+            << rockStream->config().loaderThreads << " loader threads" << std::endl;
+    }
 
-        srand(static_cast<unsigned int>(glfwGetTime())); // initialize random seed
-        float radius = 50.0;
-        float offset = 2.5f;
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glm::mat4 model = glm::mat4(1.0f);
-            // 1. translation: displace along circle with 'radius' in range [-offset, offset]
-            float angle = (float)i / (float)amount * 360.0f;
-            float displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-            float x = sin(angle) * radius + displacement;
-            displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-            float y = displacement * 0.4f; // keep height of asteroid field smaller compared to width of x and z
-            displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-            float z = cos(angle) * radius + displacement;
-            model = glm::translate(model, glm::vec3(x, y, z));
-
-            // 2. scale: Scale between 0.05 and 0.25f
-            float scale = static_cast<float>((rand() % 20) / 100.0 + 0.05);
-            model = glm::scale(model, glm::vec3(scale));
-
-            // 3. rotation: add random rotation around a (semi)randomly picked rotation axis vector
-            float rotAngle = static_cast<float>((rand() % 360));
-            model = glm::rotate(model, rotAngle, glm::vec3(0.4f, 0.6f, 0.8f));
-
-            // 4. now add to list of matrices
-            modelMatrices[i] = model;
+    // -> GPU剔除：全部实例作为点送进剔除着色器，可见的由transform feedback写进另一个缓冲，绘制直接用它
+    //    静态小行星带的实例数据只上传一次；动画时每帧从环形缓冲里读
+    std::unique_ptr<GpuInstanceCuller> gpuCuller;
+    unsigned int rockStaticBuffer = 0;
+    if (benchmark.culling == RockCulling::Gpu) {
+        gpuCuller.reset(new GpuInstanceCuller(rock, rockFormat, beltAmount));
+        if (!benchmark.animate) {
+            glGenBuffers(1, &rockStaticBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, rockStaticBuffer);
+            glBufferData(GL_ARRAY_BUFFER, rockInstanceData.size(), rockInstanceData.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
+        std::cout << "GPU culling: transform feedback, survivor count " << (gpuCuller->isIndirect()
+            ? "written to indirect draw commands on the GPU" : "read back from a query (waits for the culling pass)") << std::endl;
+    }
 
-        return modelMatrices;
-    };
+    // -> 实例缓冲挂到岩石模型上：每个网格为每个实例缓冲建一个VAO（网格自己的顶点属性0-6，实例属性从location 7开始，
+    //    mat4占4个，紧凑格式占2个）；每帧的起始实例不同，Model::DrawInstanced只在它变了时重新设置属性指针
+    rock.AttachInstanceBuffer(instanceRing.id(), rockFormat);
+    if (rockStream)
+        rock.AttachInstanceBuffer(rockStream->buffer(), rockFormat);
+
+    // -> BVH剔除：在小行星的包围球上并行建一棵层次包围盒树；动画时每帧只refit，包围盒变得太松时才重建
+    BoundingVolumeHierarchy rockBvh;
+    unsigned int rockBvhRebuilds = 0;
+    if (benchmark.culling == RockCulling::Bvh) {
+        auto bvhStart = std::chrono::steady_clock::now();
+        rockBvh.resize(beltAmount);
+        asteroidBelt.evaluate(0.0f, rockFormat, rockInstanceData.data(), workers, &rockBvh, rockSphere);
+        rockBvh.build(workers);
+        std::cout << "BVH: " << rockBvh.nodeCount() << " nodes over " << beltAmount << " asteroids, built in "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bvhStart).count() << " ms" << std::endl;
+    }
 
-    unsigned int amount = 9000;
-    glm::mat4* modelMatrices = generate_model_matrices(amount);
+    // -> 行星的model矩阵（不动）
+    glm::mat4 planetModel = glm::mat4(1.0f);
+    planetModel = glm::translate(planetModel, glm::vec3(0.0f, -3.0f, 0.0f));
+    planetModel = glm::scale(planetModel, glm::vec3(4.0f, 4.0f, 4.0f));
+
+    // -> 遮挡剔除：行星从大多数角度都挡住了一大片小行星带。每帧在CPU上把一个比行星略小的低面数球
+    //    光栅化进一个小深度缓冲（分块、SIMD、多线程），再建层次Z，小行星的包围球在提交前和它比较
+    OcclusionBuffer occlusionBuffer(256, 256 * SCR_HEIGHT / SCR_WIDTH);
+    if (benchmark.occlusion && benchmark.culling != RockCulling::Cpu && benchmark.culling != RockCulling::Bvh) {
+        std::cout << "--occlusion works with CPU or BVH culling only, ignored" << std::endl;
+        benchmark.occlusion = false;
+    }
+    if (benchmark.occlusion) {
+        // 代理球必须整个在行星里面：顶点之间的面比顶点更靠里，再留一点余量
+        BoundingSphere planetSphere = planet.GetBoundingSphere();
+        float proxyRadius = planet.GetInnerRadius(planetSphere.center) * 0.97f;
+        std::vector<glm::vec3> proxyVertices;
+        std::vector<uint32_t> proxyIndices;
+        OcclusionBuffer::sphereMesh(24, 12, proxyRadius, proxyVertices, proxyIndices);
+        occlusionBuffer.addOccluder(proxyVertices, proxyIndices, glm::translate(planetModel, planetSphere.center));
+        std::cout << "Occlusion culling: planet proxy of " << proxyIndices.size() / 3 << " triangles, "
+            << occlusionBuffer.width() << "x" << occlusionBuffer.height() << " depth buffer" << std::endl;
+    }
 
-    // -> 为4个顶点属性 (layout (location = 3) mat4) 设置属性指针，并将它们设置为实例化数组
-    unsigned int modelMatricesVBO;
-    glGenBuffers(1, &modelMatricesVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, modelMatricesVBO); // 后面那个mesh循环结束之前别解绑
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
+    // -> 远景LOD：只占几个像素的小行星不值得画完整的岩石网格。剔除后按包围球在屏幕上的直径分三档：
+    //    网格、impostor（一个四边形，贴启动时从8x8个方向烘焙的八面体图集）、点（gl_PointSize = 屏幕直径）
+    InstanceLod rockLod(24.0f, 4.0f);
+    std::unique_ptr<OctahedralImpostor> rockImpostor;
+    if (benchmark.lod && benchmark.culling != RockCulling::Cpu && benchmark.culling != RockCulling::Bvh && !benchmark.stream) {
+        std::cout << "--lod works with CPU or BVH culling or --stream only, ignored" << std::endl;
+        benchmark.lod = false;
+    }
+    if (benchmark.lod) {
+        auto bakeStart = std::chrono::steady_clock::now();
+        rockImpostor.reset(new OctahedralImpostor(rock, rockFormat, antiAliasingShader));
+        std::cout << "LOD: impostors below " << rockLod.impostorPixels() << " px (" << rockImpostor->atlasSize() << "x" << rockImpostor->atlasSize()
+            << " atlas baked in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart).count()
+            << " ms), points below " << rockLod.pointPixels() << " px" << std::endl;
+    }
 
-    for (unsigned int i = 0; i < rock.meshes.size(); i++)
-    {
-        unsigned int VAO = rock.meshes[i].VAO;
-        glBindVertexArray(VAO);
-        // 顶点属性
-        GLsizei vec4Size = sizeof(glm::vec4);
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)0);
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(vec4Size));
-        glEnableVertexAttribArray(5);
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
-
-        glVertexAttribDivisor(3, 1);
-        glVertexAttribDivisor(4, 1);
-        glVertexAttribDivisor(5, 1);
-        glVertexAttribDivisor(6, 1);
-
-        glBindVertexArray(0);
+    // -> 由近到远排序：先画近处的小行星，被它们挡住的片元在early-Z阶段就被丢掉，不再跑片元着色器。
+    //    只排要画网格的那些（impostor和点几乎不挡东西）；用GL_SAMPLES_PASSED查询数小行星网格实际写了多少个采样
+    InstanceDepthSort rockSort(benchmark.sort);
+    std::unique_ptr<GpuQueryRing> rockSamples;
+    if (benchmark.overdraw && benchmark.culling != RockCulling::Cpu && benchmark.culling != RockCulling::Bvh) {
+        std::cout << "--sort works with CPU or BVH culling only (--stream draws its chunks front to back already), ignored" << std::endl;
+        benchmark.overdraw = false;
+        rockSort.setMode(InstanceDepthSort::Mode::Off);
     }
+    if (benchmark.overdraw)
+        rockSamples.reset(new GpuQueryRing(GL_SAMPLES_PASSED));
+
+    // 小行星统计：每秒打印一次平均值
+    double rockReportStart = glfwGetTime();
+    double rockUpdateMs = 0.0, rockCullMs = 0.0, rockUploadMs = 0.0;
+    size_t rockVisibleTotal = 0, rockOccludedTotal = 0;
+    size_t rockTierTotal[InstanceLod::TierCount] = {};
+    double rockLodMs = 0.0;
+    double rockSortMs = 0.0;
+    GLuint64 rockSamplesTotal = 0;
+    unsigned int rockSampleFrames = 0;   // 采样数查询晚几帧才有结果，单独计数
+    unsigned int rockFrames = 0;
 
     // -> 屏幕四边形
     float quadVertices[] = {   // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
@@ -185,90 +412,284 @@ int main()
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-    // MSAA Off-screen render framebuffer： MSAA离屏渲染framebuffer
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-    // -> 颜色纹理组件（多重采样版）
-    unsigned int textureColorBufferMultiSampled;
-    glGenTextures(1, &textureColorBufferMultiSampled);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
-    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB, SCR_WIDTH, SCR_HEIGHT, GL_TRUE);  // 第二个参数设置的是纹理所拥有的样本个数。如果最后一个参数为GL_TRUE，图像将会对每个纹素使用相同的样本位置以及相同数量的子采样点个数。
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled, 0); // 颜色附件绑定到当前帧缓冲上
-
-    // -> 渲染缓冲对象（多重采样版）（深度与模版缓冲会使用）
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT); // 渲染缓冲对象后的参数我们将设定为样本的数量，在当前的例子中是4
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // 渲染缓冲对象附件绑定到当前帧缓冲上
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // 后处理帧缓冲 (screenShdaer will be applied)
-    unsigned int intermediateFBO;
-    glGenFramebuffers(1, &intermediateFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, intermediateFBO);
-
-    // -> 颜色附件
-    unsigned int screenTexture;
-    glGenTextures(1, &screenTexture);
-    glBindTexture(GL_TEXTURE_2D, screenTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, screenTexture, 0);	// we only need a color buffer
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        cout << "ERROR::FRAMEBUFFER:: Intermediate framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // 指定 shader 中 纹理采样器所指向的纹理单元（前面的纹理默认绑定到纹理单元0上）
-    antiAliasingPostShader.use();
-    antiAliasingPostShader.setInt("screenTexture", 0);
+    // 离屏渲染目标放在池子里：每帧按（格式、采样数、大小）取用，用完归还，同一帧里后面同类的pass直接复用；
+    // 窗口大小改变时旧尺寸的目标被删掉、按新尺寸重建。--target-format 选中间目标的格式（R11G11B10F和RGBA8一样每像素4字节，却能存HDR）
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight); // 高DPI屏幕上比窗口大
+    RenderTargetPool renderTargets(framebufferWidth, framebufferHeight);
+    // 默认帧缓冲（后缓冲）的格式和离屏目标一样时，MSAA才能直接解析进去；RGB8、sRGB等就走解析目标
+    const bool backBufferMatchesTarget = defaultFramebufferHasFormat(benchmark.targetFormat);
+    // -> 场景目标：MSAA时是多重采样颜色纹理 + 多重采样的深度模板渲染缓冲（采样数由画质档位决定，默认4x）；
+    //    TAA时是单采样的，深度是纹理（重投影要读）
+    RenderTargetDesc sceneTargetDesc;
+    sceneTargetDesc.colorFormat = benchmark.targetFormat;
+    sceneTargetDesc.depthFormat = GL_DEPTH24_STENCIL8;
+    // -> 后处理的输入：MSAA目标解析（blit）到这里，格式必须和MSAA目标一样
+    RenderTargetDesc resolveTargetDesc;
+    resolveTargetDesc.colorFormat = benchmark.targetFormat;
+    // -> 后处理链的中间目标总是屏幕大小（最后一个pass把缩小的场景放大到屏幕）
+    RenderTargetDesc postTargetDesc;
+    postTargetDesc.colorFormat = benchmark.targetFormat;
+    // -> TAA的历史帧：场景大小，半精度（新帧只占0.1，8位格式里最后几级灰度永远收敛不过去）
+    RenderTargetDesc taaHistoryDesc;
+    taaHistoryDesc.colorFormat = GL_RGBA16F;
+    bool reportRenderTargets = true;
+
+    // -> 画质调节器：帧时间超出目标就降一档（先减MSAA采样数，再降渲染分辨率，远处的小行星更早变成impostor/点），
+    //    连续几个窗口都明显低于目标才升一档；档位改变时场景目标按新的缩放和采样数从池子里重新取
+    std::unique_ptr<QualityGovernor> governor;
+    if (benchmark.governorMs > 0.0) {
+        QualityGovernorSettings governorSettings;
+        governorSettings.targetMs = benchmark.governorMs;
+        governor.reset(new QualityGovernor(governorSettings));
+        std::cout << "Quality governor: target " << governorSettings.targetMs << " ms, " << governor->levelCount() << " levels from "
+            << QualityGovernor::describe(governor->level()) << std::endl;
+    }
+    AntiAliasingMode antiAliasing = benchmark.antiAliasing;
+    QualityLevel quality = governor ? governor->level() : QualityLevel();
+    auto applyQuality = [&](const QualityLevel& level) {
+        quality = level;
+        sceneTargetDesc.scale = resolveTargetDesc.scale = taaHistoryDesc.scale = level.renderScale;
+        sceneTargetDesc.samples = antiAliasing == AntiAliasingMode::Msaa ? level.msaaSamples : 0; // 其他方式都是每像素一个采样
+        sceneTargetDesc.sampledDepth = antiAliasing == AntiAliasingMode::Taa;
+        rockLod.setThresholds(24.0f * level.lodBias, 4.0f * level.lodBias);
+    };
+    applyQuality(quality);
+
+    std::cout << "Post-processing: " << postChain.describe() << " in " << postChain.passCount() << " full-screen pass"
+        << (postChain.passCount() > 1 ? "es" : "") << " (with FXAA: " << fxaaPostChain.describe() << ")" << std::endl;
+
+    // 抗锯齿的GPU耗时：场景（MSAA的代价主要在这里）和场景之后的解析 + 后处理分开计时；
+    // 它们嵌在整帧的计时里面，所以用时间戳而不是GL_TIME_ELAPSED查询
+    GpuTimer sceneGpuTimer(4, true), resolveGpuTimer(4, true);
+    double aaReportStart = glfwGetTime();
+    double aaSceneMs = 0.0, aaResolveMs = 0.0;
+    unsigned int aaSceneFrames = 0, aaResolveFrames = 0;
+    unsigned long long aaModeFrame = 0;   // 结果晚几帧才到：切换之前的帧不算进新的方式
+    bool aaKeyDown = false;
+    auto setAntiAliasing = [&](AntiAliasingMode mode, unsigned long long frame) {
+        if (antiAliasing == AntiAliasingMode::Taa)
+            temporalAA.reset(renderTargets);
+        antiAliasing = mode;
+        applyQuality(quality);
+        aaModeFrame = frame;
+        aaSceneMs = aaResolveMs = 0.0;
+        aaSceneFrames = aaResolveFrames = 0;
+        reportRenderTargets = true;
+        std::cout << "Anti-aliasing: " << antiAliasingModeName(mode) << std::endl;
+    };
+    std::cout << "Anti-aliasing: " << antiAliasingModeName(antiAliasing) << " (F to switch), MSAA "
+        << (backBufferMatchesTarget ? "can resolve into the back buffer" : "resolves through a target: the back buffer's format differs from "
+            + std::string(renderTargetFormatName(benchmark.targetFormat))) << std::endl;
+
+    // 每帧耗时：CPU是一帧的提交时间（不含SwapBuffers的等待），GPU用计时查询，结果晚几帧才到
+    GpuTimer frameGpuTimer;
+    FrameTimingLog frameTimings;
+    unsigned long long frameIndex = 0;
+    CameraPath recordedPath;
+    float recordStart = static_cast<float>(glfwGetTime());
+    // 相机模拟以固定的120Hz步长运行，与帧率无关
+    CameraSimulation cameraSimulation(camera);
+    if (cameraPlayback) {
+        glfwSwapInterval(0); // 不等垂直同步，测的是实际能跑多快
+        std::cout << "Camera playback: " << cameraPath.duration() << " s at a fixed step of " << benchmark.fixedStep << " s" << std::endl;
+    }
 
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
     {
+        auto cpuFrameStart = std::chrono::steady_clock::now();
+
         // per-frame time logic
         float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        float animationTime = currentFrame;
 
 
         // input
         // -----
         processInput(window);
+        // F：下一种抗锯齿方式（off -> msaa -> fxaa -> taa）
+        bool aaKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+        if (aaKey && !aaKeyDown)
+            setAntiAliasing(static_cast<AntiAliasingMode>(((int)antiAliasing + 1) % 4), frameIndex);
+        aaKeyDown = aaKey;
+
+        if (cameraPlayback) {
+            // 回放：第N帧总是看到路径上 N * fixedStep 时刻的画面，与机器快慢无关
+            float simulatedTime = frameIndex * benchmark.fixedStep;
+            if (simulatedTime > cameraPath.duration()) {
+                glfwSetWindowShouldClose(window, true);
+                break;
+            }
+            cameraPath.apply(simulatedTime, camera);
+            animationTime = simulatedTime;
+        }
+        else {
+            // simulation：处理到当前时刻为止的输入事件，跑完能放下的固定步长；渲染用最后两个模拟状态之间的插值
+            cameraSimulation.advance(glfwGetTime(), inputQueue);
+            cameraSimulation.interpolated().applyTo(camera);
+            if (!benchmark.recordPath.empty())
+                recordedPath.record(currentFrame - recordStart, camera);
+        }
+
+        for (const GpuTimer::Result& result : frameGpuTimer.collect()) {
+            frameTimings.gpu(result.tag, result.ms);
+            if (governor)
+                governor->gpu(result.tag, result.ms);
+        }
+        for (const GpuTimer::Result& result : sceneGpuTimer.collect())
+            if (result.tag >= aaModeFrame) {
+                aaSceneMs += result.ms;
+                aaSceneFrames++;
+            }
+        for (const GpuTimer::Result& result : resolveGpuTimer.collect())
+            if (result.tag >= aaModeFrame) {
+                aaResolveMs += result.ms;
+                aaResolveFrames++;
+            }
+        if (governor && governor->update(frameIndex)) {
+            applyQuality(governor->level());
+            reportRenderTargets = true;
+        }
+        frameGpuTimer.begin(frameIndex);
 
         // render
         // ------
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // 1. 在 MSAA离屏渲染framebuffer 中 渲染场景
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        // 1. 在离屏渲染framebuffer（MSAA时多重采样）中 渲染场景（窗口大小变了先按新大小重建；最小化时帧缓冲是0x0，池子保持原来的大小）
+        if (renderTargets.resize(framebufferWidth, framebufferHeight))
+            reportRenderTargets = true;
+        const int frameWidth = renderTargets.width(), frameHeight = renderTargets.height();
+        occlusionBuffer.resize(256, 256 * frameHeight / frameWidth); // 遮挡深度缓冲跟着窗口的宽高比，遮挡体保留
+        RenderTarget* sceneTarget = renderTargets.acquire(sceneTargetDesc);
+        const int sceneWidth = sceneTarget->width, sceneHeight = sceneTarget->height; // 画质调节器缩放后的渲染分辨率
+        sceneGpuTimer.begin(frameIndex);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneTarget->fbo);
+        glViewport(0, 0, sceneWidth, sceneHeight);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glEnable(GL_DEPTH_TEST);
 
+        // 这一帧的相机：矩阵只在输入改变时重新计算；快照不可变，剔除线程读它时主线程仍可以移动相机
+        //    TAA时投影每帧偏移不到一个像素（只用于光栅化；剔除、LOD和重投影用不抖动的矩阵）
+        camera.SetJitter(antiAliasing == AntiAliasingMode::Taa ? TemporalAA::jitter(frameIndex, sceneWidth, sceneHeight) : glm::vec2(0.0f));
+        std::shared_ptr<const CameraSnapshot> frameCamera = camera.Publish();
+        const glm::mat4& projection = frameCamera->jitteredProjection;
+        const glm::mat4& view = frameCamera->view;
+
+        // -> 小行星的更新 + 剔除 + 上传：等到这一帧的环形缓冲区域可写（GPU已用完三帧前的数据）后，
+        //    动画时并行计算每颗小行星的新变换；CPU剔除时只把可见实例写进这一帧的实例缓冲。
+        //    放在行星之前提交：GPU剔除在3.3上要等剔除pass的结果，这样等的时间最短
+        instanceRing.beginFrame();
+        auto rockStart = std::chrono::steady_clock::now();
+        auto rockLap = [&]() {
+            auto now = std::chrono::steady_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(now - rockStart).count();
+            rockStart = now;
+            return ms;
+        };
+        size_t visibleRocks = beltAmount;
+        RingAllocation rockInstances, impostorInstances, pointInstances;
+        float rockPixelScale = InstanceLod::pixelScale(projection, sceneHeight);
+        bool sortRocks = rockSort.mode() != InstanceDepthSort::Mode::Off;
+        auto writeSortedRocks = [&](const std::vector<uint32_t>& list, auto& culler, void* out) {
+            rockSort.sort(list, culler, frameCamera->position, frameCamera->front, workers);
+            rockSort.write(rockInstanceData.data(), rockStride, out, workers);
+            rockSortMs += rockSort.stats().sortMs;
+        };
+        // 把剔除后可见的实例写进这一帧的缓冲；开了LOD时每一档各写一段，排序时网格那段由近到远
+        auto writeVisibleRocks = [&](auto& culler) {
+            if (!rockImpostor) {
+                rockInstances = instanceRing.allocate(visibleRocks * rockStride, rockStride);
+                if (sortRocks)
+                    writeSortedRocks(culler.visibleIndices(), culler, rockInstances.data);
+                else
+                    culler.writeVisible(rockInstanceData.data(), rockStride, rockInstances.data, workers);
+                return;
+            }
+            rockLod.classify(culler, frameCamera->position, rockPixelScale, workers);
+            rockInstances = instanceRing.allocate(rockLod.count(InstanceLod::Mesh) * rockStride, rockStride);
+            if (sortRocks)
+                writeSortedRocks(rockLod.indices(InstanceLod::Mesh), culler, rockInstances.data);
+            else
+                rockLod.write(InstanceLod::Mesh, rockInstanceData.data(), rockStride, rockInstances.data, workers);
+            impostorInstances = instanceRing.allocate(rockLod.count(InstanceLod::Impostor) * rockStride, rockStride);
+            rockLod.write(InstanceLod::Impostor, rockInstanceData.data(), rockStride, impostorInstances.data, workers);
+            pointInstances = instanceRing.allocate(rockLod.count(InstanceLod::Point) * rockStride, rockStride);
+            rockLod.write(InstanceLod::Point, rockInstanceData.data(), rockStride, pointInstances.data, workers);
+            rockLodMs += rockLod.stats().classifyMs;
+            for (int tier = 0; tier < InstanceLod::TierCount; tier++)
+                rockTierTotal[tier] += rockLod.stats().count[tier];
+        };
+        const OcclusionBuffer* occlusion = nullptr;
+        if (benchmark.occlusion) {
+            occlusionBuffer.render(frameCamera->view, frameCamera->projection, frameCamera->nearPlane, workers);
+            occlusion = &occlusionBuffer;
+            rockCullMs += rockLap();
+        }
+        if (rockStream) {
+            rockStream->update(frameCamera->position, frameCamera->frustum);
+            visibleRocks = 0;
+            for (const InstanceStream::Draw& draw : rockStream->draws())
+                visibleRocks += draw.count;
+            rockUploadMs += rockLap(); // 换入的块在这里上传
+        }
+        else if (benchmark.culling == RockCulling::Cpu) {
+            if (benchmark.animate)
+                asteroidBelt.evaluate(animationTime, rockFormat, rockInstanceData.data(), workers, &rockCuller, rockSphere);
+            rockUpdateMs += rockLap();
+            visibleRocks = rockCuller.cull(frameCamera->frustum, workers, occlusion);
+            rockOccludedTotal += rockCuller.stats().occluded;
+            rockCullMs += rockLap();
+            writeVisibleRocks(rockCuller);
+        }
+        else if (benchmark.culling == RockCulling::Bvh) {
+            if (benchmark.animate) {
+                // 公转让同一个叶子里的小行星慢慢分开：refit之后包围盒总面积超过建树时的两倍就重建
+                asteroidBelt.evaluate(animationTime, rockFormat, rockInstanceData.data(), workers, &rockBvh, rockSphere);
+                rockBvh.refit(workers);
+                if (rockBvh.refitCost() > 2.0f) {
+                    rockBvh.build(workers);
+                    rockBvhRebuilds++;
+                }
+            }
+            rockUpdateMs += rockLap();
+            visibleRocks = rockBvh.cull(frameCamera->frustum, workers, occlusion);
+            rockOccludedTotal += rockBvh.stats().occluded;
+            rockCullMs += rockLap();
+            writeVisibleRocks(rockBvh);
+        }
+        else if (benchmark.culling == RockCulling::Gpu) {
+            // 剔除着色器读全部实例：静态时是一次性上传的缓冲，动画时是这一帧写进环形缓冲的数据
+            unsigned int rockSource = rockStaticBuffer;
+            if (benchmark.animate) {
+                rockInstances = instanceRing.allocate(beltAmount * rockStride, rockStride);
+                asteroidBelt.evaluate(animationTime, rockFormat, rockInstances.data, workers);
+                instanceRing.commit();
+                rockSource = instanceRing.id();
+            }
+            rockUpdateMs += rockLap();
+            gpuCuller->cull(rockSource, rockInstances.offset, beltAmount, frameCamera->frustum);
+            rockCullMs += rockLap(); // 只是提交的时间，剔除本身在GPU上
+        }
+        else {
+            rockInstances = instanceRing.allocate(beltAmount * rockStride, rockStride);
+            if (benchmark.animate)
+                asteroidBelt.evaluate(animationTime, rockFormat, rockInstances.data, workers);
+            else
+                std::memcpy(rockInstances.data, rockInstanceData.data(), beltAmount * rockStride);
+        }
+        instanceRing.commit();
+        rockUploadMs += rockLap();
+
         // -> 渲染：中心行星
         antiAliasingShader.use();
+        antiAliasingShader.setMatrix4(uniforms::projection, projection);
+        antiAliasingShader.setMatrix4(uniforms::view, view);
 
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 500.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        antiAliasingShader.setMatrix4("projection", projection);
-        antiAliasingShader.setMatrix4("view", view);
-
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
-        antiAliasingShader.setMatrix4("model", model);
+        antiAliasingShader.setMatrix4(uniforms::model, planetModel);
         planet.Draw(antiAliasingShader);
 
         // -> 渲染：小行星
@@ -279,35 +700,174 @@ int main()
         //}
 
         antiAliasingShader2.use();
-        antiAliasingShader2.setMatrix4("projection", projection);
-        antiAliasingShader2.setMatrix4("view", view); // 注意：接下来不再手动传入model矩阵了，而是用前面设定的顶点属性3去实现渲染实例时的model矩阵变换
+        antiAliasingShader2.setMatrix4(uniforms::projection, projection);
+        antiAliasingShader2.setMatrix4(uniforms::view, view); // 注意：接下来不再手动传入model矩阵了，而是用实例属性（location 7起）去实现渲染实例时的model矩阵变换
+
+        if (gpuCuller) {
+            // 实例数据是剔除pass的输出，数量由查询得到（4.4上GPU直接写进间接绘制命令）
+            gpuCuller->draw(antiAliasingShader2);
+            visibleRocks = gpuCuller->stats().visible;
+            rockCullMs += gpuCuller->stats().waitMs; // 3.3上等查询结果的时间
+        }
+        else if (rockStream) {
+            // 按块画：块里最大的小行星离相机最近时在屏幕上也很小，开了LOD就整块画成impostor或点
+            float largestRock = rockSphere.radius * beltParams.maxScale;
+            for (const InstanceStream::Draw& draw : rockStream->draws()) {
+                float pixels = 2.0f * largestRock * rockPixelScale / std::max(draw.distance, 0.001f);
+                if (rockImpostor && pixels < rockLod.pointPixels()) {
+                    rockImpostor->drawPoints(rockStream->buffer(), draw.offset, draw.count, view, projection, rockPixelScale);
+                    rockTierTotal[InstanceLod::Point] += draw.count;
+                    continue;
+                }
+                if (rockImpostor && pixels < rockLod.impostorPixels()) {
+                    rockImpostor->drawImpostors(rockStream->buffer(), draw.offset, draw.count, view, projection, frameCamera->position);
+                    rockTierTotal[InstanceLod::Impostor] += draw.count;
+                    continue;
+                }
+                antiAliasingShader2.use();
+                rock.DrawInstanced(antiAliasingShader2, rockStream->buffer(), draw.count, draw.offset / rockStride);
+                rockTierTotal[InstanceLod::Mesh] += draw.count;
+            }
+        }
+        else {
+            // 每个网格绑定自己的纹理后用glDrawElementsInstanced画（mesh.h 里的 Draw 用的是 glDrawElements）；
+            // 环形缓冲的分配按实例大小对齐，偏移正好是整数个实例
+            size_t meshRocks = rockImpostor ? rockLod.count(InstanceLod::Mesh) : visibleRocks;
+            if (rockSamples) {
+                for (const GpuQueryRing::Result& result : rockSamples->collect()) {
+                    rockSamplesTotal += result.value;
+                    rockSampleFrames++;
+                }
+                rockSamples->begin(frameIndex);
+            }
+            rock.DrawInstanced(antiAliasingShader2, instanceRing.id(), meshRocks, rockInstances.offset / rockStride);
+            if (rockSamples)
+                rockSamples->end();
+        }
+        if (rockImpostor && !rockStream) {
+            rockImpostor->drawImpostors(instanceRing.id(), impostorInstances.offset, rockLod.count(InstanceLod::Impostor), view, projection, frameCamera->position);
+            rockImpostor->drawPoints(instanceRing.id(), pointInstances.offset, rockLod.count(InstanceLod::Point), view, projection, rockPixelScale);
+        }
 
-        for (unsigned int i = 0; i < rock.meshes.size(); i++)
-        {
-            glBindVertexArray(rock.meshes[i].VAO);
-            // 这里用glDrawElementsInstanced 是因为在 mesh.h 里面的 draw 也是用的 glDrawElements
-            glDrawElementsInstanced(GL_TRIANGLES, rock.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, amount);
+        rockVisibleTotal += visibleRocks;
+        rockFrames++;
+        if (currentFrame - rockReportStart >= 1.0) {
+            // 吞吐量 = 每毫秒写进实例缓冲的实例数（更新 + 写出；不含剔除）
+            double streamMs = rockUpdateMs + rockUploadMs;
+            std::string cullInfo = InstanceCuller::simdName();
+            if (gpuCuller)
+                cullInfo = "GPU, submit only";
+            else if (rockStream)
+                cullInfo = "chunks, " + std::to_string(rockStream->draws().size()) + " drawn of " + std::to_string(rockStream->stats().resident)
+                    + " resident, " + std::to_string(rockStream->stats().loading) + " loading, " + std::to_string(rockStream->stats().uploads)
+                    + " uploaded and " + std::to_string(rockStream->stats().evictions) + " evicted in "
+                    + std::to_string(rockStream->stats().uploadMs) + " ms, loaders busy " + std::to_string(rockStream->stats().loadMs) + " ms";
+            else if (benchmark.culling == RockCulling::Bvh)
+                cullInfo = "BVH, " + std::to_string(rockBvh.stats().nodesVisited) + " nodes visited, " + std::to_string(rockBvh.stats().tested)
+                    + " rocks tested one by one, " + std::to_string(rockBvhRebuilds) + " rebuilds";
+            if (benchmark.occlusion)
+                cullInfo += ", " + std::to_string(rockOccludedTotal / rockFrames) + " occluded by the planet (raster "
+                    + std::to_string(occlusionBuffer.stats().renderMs) + " ms)";
+            if (rockImpostor)
+                cullInfo += ", LOD " + std::to_string(rockTierTotal[InstanceLod::Mesh] / rockFrames) + " mesh / "
+                    + std::to_string(rockTierTotal[InstanceLod::Impostor] / rockFrames) + " impostor / "
+                    + std::to_string(rockTierTotal[InstanceLod::Point] / rockFrames) + " point (binning "
+                    + std::to_string(rockLodMs / rockFrames) + " ms, in upload)";
+            if (sortRocks)
+                cullInfo += ", sorted front to back (" + std::string(InstanceDepthSort::modeName(rockSort.mode())) + ", "
+                    + std::to_string(rockSortMs / rockFrames) + " ms, in upload)";
+            if (rockSamples && rockSampleFrames > 0) {
+                // 每个屏幕采样被小行星网格写了几次（MSAA时一个像素有多个采样）
+                double samplesPerFrame = double(rockSamplesTotal) / rockSampleFrames;
+                double screenSamples = double(sceneWidth) * sceneHeight * std::max(sceneTargetDesc.samples, 1);
+                cullInfo += ", rock meshes wrote " + std::to_string((unsigned long long)samplesPerFrame) + " samples ("
+                    + std::to_string(samplesPerFrame / screenSamples) + " per screen sample)";
+            }
+            std::cout << "Asteroids: " << amount << " tested, " << rockVisibleTotal / rockFrames << " visible; per frame "
+                << rockUpdateMs / rockFrames << " ms update, " << rockCullMs / rockFrames << " ms cull ("
+                << cullInfo << "), " << rockUploadMs / rockFrames << " ms upload; "
+                << (streamMs > 0.0 ? rockVisibleTotal / streamMs : 0.0) << " instances/ms on " << workers.size()
+                << " threads, " << instanceRing.stallCount() << " ring stalls" << std::endl;
+            rockReportStart = currentFrame;
+            rockUpdateMs = rockCullMs = rockUploadMs = 0.0;
+            rockVisibleTotal = rockOccludedTotal = 0;
+            rockTierTotal[InstanceLod::Mesh] = rockTierTotal[InstanceLod::Impostor] = rockTierTotal[InstanceLod::Point] = 0;
+            rockLodMs = 0.0;
+            rockSortMs = 0.0;
+            rockSamplesTotal = 0;
+            rockSampleFrames = 0;
+            if (rockStream)
+                rockStream->resetStats();
+            rockFrames = 0;
         }
 
-        // 2. now blit multisampled buffer(s) to normal colorbuffer of intermediate FBO. Image is stored in screenTexture
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer); // source
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBO); // destination
-        glBlitFramebuffer(
-            0, 0, SCR_WIDTH, SCR_HEIGHT, // src p1, p2
-            0, 0, SCR_WIDTH, SCR_HEIGHT, // des p1, p2
-            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        sceneGpuTimer.end();
+        resolveGpuTimer.begin(frameIndex);
+
+        // 2. now blit multisampled buffer(s) to normal colorbuffer of intermediate FBO. Image is stored in resolveTarget->color
+        //    （没有多重采样时场景目标本身就是普通纹理，不用再复制一遍）
+        RenderTarget* resolveTarget = sceneTarget;
+        bool ownsResolveTarget = true;   // TAA的输出是它的历史帧，不能还给池子
+        // MSAA且没有后处理、也不用放大时：直接解析进默认帧缓冲，省掉中间目标和一个全屏pass
+        //    （多重采样的blit要求两边格式相同，启动时查过默认帧缓冲的格式）
+        bool directResolve = sceneTargetDesc.samples > 0 && postChain.empty() && sceneWidth == frameWidth && sceneHeight == frameHeight
+            && backBufferMatchesTarget;
+        if (sceneTargetDesc.samples > 0) {
+            resolveTarget = directResolve ? nullptr : renderTargets.acquire(resolveTargetDesc);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneTarget->fbo); // source
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, directResolve ? 0 : resolveTarget->fbo); // destination
+            glBlitFramebuffer(
+                0, 0, sceneWidth, sceneHeight, // src p1, p2
+                0, 0, sceneWidth, sceneHeight, // des p1, p2
+                GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            renderTargets.release(sceneTarget);
+        }
+        else if (antiAliasing == AntiAliasingMode::Taa) {
+            resolveTarget = temporalAA.resolve(*sceneTarget, *frameCamera, renderTargets, taaHistoryDesc, quadVAO);
+            ownsResolveTarget = false;
+            renderTargets.release(sceneTarget);
+        }
 
-        // 3. 复制完成后，现在可以渲染后处理四边形了（现在intermediateFBO中的screenTexture附件可被着色器采样）
-        glBindFramebuffer(GL_FRAMEBUFFER, 0); // 在默认缓冲中渲染
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
+        // 3. 复制完成后，现在可以渲染后处理四边形了（现在resolveTarget的颜色纹理可被着色器采样）：
+        //    后处理链的最后一个pass画进默认缓冲（渲染分辨率缩小时顺便放大到屏幕），中间结果用池子里屏幕大小的目标来回倒
+        PostProcessChain& frameChain = antiAliasing == AntiAliasingMode::Fxaa ? fxaaPostChain : postChain;
+        if (resolveTarget) {
+            frameChain.apply(resolveTarget->color, sceneWidth, sceneHeight, renderTargets, postTargetDesc, quadVAO, 0);
+            if (ownsResolveTarget)
+                renderTargets.release(resolveTarget);
+        }
+        resolveGpuTimer.end();
+        renderTargets.endFrame();
+        if (reportRenderTargets) {
+            RenderTargetPool::Stats targetStats = renderTargets.stats();
+            std::cout << "Render targets: " << frameWidth << "x" << frameHeight << " " << renderTargetFormatName(benchmark.targetFormat)
+                << ", scene " << sceneWidth << "x" << sceneHeight << " with " << sceneTargetDesc.samples << "x MSAA, "
+                << targetStats.targets << " targets, " << targetStats.bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+            reportRenderTargets = false;
+        }
+        if (currentFrame - aaReportStart >= 1.0 && aaResolveFrames > 0) {
+            std::string aaInfo = antiAliasingModeName(antiAliasing);
+            if (sceneTargetDesc.samples > 0)
+                aaInfo += " " + std::to_string(sceneTargetDesc.samples) + "x, " + (directResolve ? "resolved into the default framebuffer" : "resolve blit");
+            else if (antiAliasing == AntiAliasingMode::Taa)
+                aaInfo += ", resolve pass";
+            if (!directResolve)
+                aaInfo += ", " + std::to_string(frameChain.passCount()) + " post pass" + (frameChain.passCount() > 1 ? "es" : "")
+                    + (antiAliasing == AntiAliasingMode::Fxaa ? " (FXAA in the first)" : "");
+            std::cout << "Anti-aliasing: " << aaInfo << "; GPU " << (aaSceneFrames > 0 ? aaSceneMs / aaSceneFrames : 0.0) << " ms scene + "
+                << aaResolveMs / aaResolveFrames << " ms resolve and post" << std::endl;
+            aaReportStart = currentFrame;
+            aaSceneMs = aaResolveMs = 0.0;
+            aaSceneFrames = aaResolveFrames = 0;
+        }
 
-        antiAliasingPostShader.use();
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, screenTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        instanceRing.endFrame();
+        frameGpuTimer.end();
+        double cpuFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuFrameStart).count();
+        frameTimings.cpu(frameIndex, cpuFrameMs);
+        if (governor)
+            governor->cpu(frameIndex, cpuFrameMs);
+        frameIndex++;
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -316,7 +876,23 @@ int main()
         glfwPollEvents();
     }
 
-    delete[] modelMatrices;
+    for (const GpuTimer::Result& result : frameGpuTimer.drain())
+        frameTimings.gpu(result.tag, result.ms);
+    if (cameraPlayback)
+        frameTimings.printSummary("Camera playback (" + (benchmark.builtinPath.empty() ? benchmark.replayPath : benchmark.builtinPath) + ")");
+    if (!benchmark.timingsPath.empty() && frameTimings.writeCsv(benchmark.timingsPath))
+        std::cout << "Frame timings written to " << benchmark.timingsPath << std::endl;
+    if (governor && !benchmark.governorLogPath.empty() && governor->writeCsv(benchmark.governorLogPath))
+        std::cout << "Quality governor decisions (" << governor->decisions().size() << ") written to " << benchmark.governorLogPath << std::endl;
+    if (!benchmark.recordPath.empty() && recordedPath.save(benchmark.recordPath))
+        std::cout << "Camera path (" << recordedPath.keys.size() << " frames) written to " << benchmark.recordPath << std::endl;
+
+    gpuCuller.reset();
+    rockImpostor.reset();
+    rockStream.reset();
+    if (rockStaticBuffer)
+        glDeleteBuffers(1, &rockStaticBuffer);
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -330,34 +906,7 @@ void processInput(GLFWwindow* window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
-
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
-
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
-
-    // 为了方便远程的尝试
-    const float keyboardMovmentSpeed = 5.0f;
-
-    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS)
-        camera.ProcessMouseMovement(0.0f, keyboardMovmentSpeed);
-    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
-        camera.ProcessMouseMovement(0.0f, -keyboardMovmentSpeed);
-    if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)
-        camera.ProcessMouseMovement(-keyboardMovmentSpeed, 0.0f);
-    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
-        camera.ProcessMouseMovement(keyboardMovmentSpeed, 0.0f);
+    // 相机移动（WASD）和键盘视角（IJKL，为了方便远程的尝试）在 CameraSimulation::tick 里按键的按下/松开状态处理
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -367,29 +916,112 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    framebufferWidth = width;   // 离屏渲染目标在下一帧开始时按新大小重建
+    framebufferHeight = height;
+    if (width > 0 && height > 0) // 0 when minimized
+        camera.SetProjection((float)width / (float)height, camera.GetNearPlane(), camera.GetFarPlane());
 }
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
+    if (cameraPlayback)
+        return;
+
+    InputEvent event;
+    event.type = InputEvent::CursorPos;
+    event.time = glfwGetTime();
+    event.x = xposIn;
+    event.y = yposIn;
+    inputQueue.push(event);
+}
 
-    float xpos = static_cast<float>(xposIn);
-    float ypos = static_cast<float>(yposIn);
-
-    if (firstMouse) {
-        lastX = xpos;
-        lastY = ypos;
-        firstMouse = false;
-    }
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+    if (cameraPlayback)
+        return;
+
+    InputEvent event;
+    event.type = InputEvent::Scroll;
+    event.time = glfwGetTime();
+    event.x = xoffset;
+    event.y = yoffset;
+    inputQueue.push(event);
+}
 
-    float xoffset = xpos - lastX;
-    float yoffset = -ypos + lastY; // reversed since y-coordinates go from bottom to top
-    lastX = xpos;
-    lastY = ypos;
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (cameraPlayback)
+        return;
 
-    camera.ProcessMouseMovement(xoffset, yoffset);
+    InputEvent event;
+    event.type = InputEvent::Key;
+    event.time = glfwGetTime();
+    event.key = key;
+    event.action = action;
+    inputQueue.push(event);
 }
 
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
-    camera.ProcessMouseScroll(static_cast<float>(yoffset));
+BenchmarkOptions parseBenchmarkOptions(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--record") == 0 && hasValue)
+            options.recordPath = argv[++i];
+        else if (std::strcmp(argv[i], "--replay") == 0 && hasValue)
+            options.replayPath = argv[++i];
+        else if (std::strcmp(argv[i], "--path") == 0 && hasValue)
+            options.builtinPath = argv[++i];
+        else if (std::strcmp(argv[i], "--timings") == 0 && hasValue)
+            options.timingsPath = argv[++i];
+        else if (std::strcmp(argv[i], "--dt") == 0 && hasValue)
+            options.fixedStep = static_cast<float>(std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--rocks") == 0 && hasValue)
+            options.rocks = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--animate") == 0)
+            options.animate = true;
+        else if (std::strcmp(argv[i], "--no-cull") == 0)
+            options.culling = RockCulling::None;
+        else if (std::strcmp(argv[i], "--gpu-cull") == 0)
+            options.culling = RockCulling::Gpu;
+        else if (std::strcmp(argv[i], "--bvh-cull") == 0)
+            options.culling = RockCulling::Bvh;
+        else if (std::strcmp(argv[i], "--occlusion") == 0)
+            options.occlusion = true;
+        else if (std::strcmp(argv[i], "--lod") == 0)
+            options.lod = true;
+        else if (std::strcmp(argv[i], "--stream") == 0)
+            options.stream = true;
+        else if (std::strcmp(argv[i], "--sort") == 0 && hasValue) {
+            options.overdraw = true;
+            if (!InstanceDepthSort::parseMode(argv[++i], options.sort))
+                std::cout << "Unknown sort mode " << argv[i] << " (off, buckets, radix)" << std::endl;
+        }
+        else if (std::strcmp(argv[i], "--target-format") == 0 && hasValue) {
+            if (!parseRenderTargetFormat(argv[++i], options.targetFormat))
+                std::cout << "Unknown render target format " << argv[i] << " (rgba8, rgb10a2, r11g11b10f, rgba16f)" << std::endl;
+        }
+        else if (std::strcmp(argv[i], "--post") == 0 && hasValue)
+            options.postEffects = argv[++i];
+        else if (std::strcmp(argv[i], "--governor") == 0 && hasValue)
+            options.governorMs = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--governor-log") == 0 && hasValue)
+            options.governorLogPath = argv[++i];
+        else if (std::strcmp(argv[i], "--aa") == 0 && hasValue) {
+            if (!parseAntiAliasingMode(argv[++i], options.antiAliasing))
+                std::cout << "Unknown anti-aliasing mode " << argv[i] << " (off, msaa, fxaa, taa)" << std::endl;
+        }
+        else if (std::strcmp(argv[i], "--blur-sigma") == 0 && hasValue)
+            options.blurSigma = static_cast<float>(std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--instance-format") == 0 && hasValue) {
+            if (!parseInstanceFormat(argv[++i], options.instanceFormat))
+                std::cout << "Unknown instance format " << argv[i] << " (matrix, quat, half)" << std::endl;
+        }
+        else
+            std::cout << "Unknown argument " << argv[i] << " (--record <file>, --replay <file>, --path orbit|belt|planet, --timings <file.csv>, --dt <seconds>, --rocks <count>, --seed <n>, --instance-format matrix|quat|half, --animate, --no-cull, --gpu-cull, --bvh-cull, --occlusion, --lod, --stream, --sort off|buckets|radix, --target-format rgba8|rgb10a2|r11g11b10f|rgba16f, --post <effect,...>, --blur-sigma <px>, --governor <ms>, --governor-log <file.csv>, --aa off|msaa|fxaa|taa)" << std::endl;
+    }
+    if (options.fixedStep <= 0.0f)
+        options.fixedStep = 1.0f / 60.0f;
+    return options;
 }
 
 // utility function for loading a 2D texture from file
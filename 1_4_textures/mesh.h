@@ -5,6 +5,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader_s.h"
+#include "instance_format.h"
 
 #include <string>
 #include <vector>
@@ -52,19 +53,81 @@ public:
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
+        setupSamplerNames();
     }
 
     // render the mesh
     void Draw(Shader& shader)
     {
         // bind appropriate textures
+        BindTextures(shader);
+
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render 'count' instances through a VAO from CreateInstancedVAO (Model::DrawInstanced keeps
+    // its instance attributes pointed at the right instances)
+    void DrawInstanced(Shader& shader, unsigned int instancedVAO, GLsizei count)
+    {
+        BindTextures(shader);
+
+        glBindVertexArray(instancedVAO);
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0, count);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // a second VAO over this mesh's vertex and index buffers, plus the instance attributes of
+    // 'format' in 'instanceBuffer' from InstanceAttributeLocation on (divisor 1, offset 0). The
+    // mesh's own VAO stays as it is, so Draw() is not affected.
+    unsigned int CreateInstancedVAO(unsigned int instanceBuffer, InstanceFormat format)
+    {
+        unsigned int instancedVAO;
+        glGenVertexArrays(1, &instancedVAO);
+        glBindVertexArray(instancedVAO);
+        setupVertexAttributes();
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        enableInstanceAttributes(format, InstanceAttributeLocation, 1);
+        setInstanceAttributes(format, InstanceAttributeLocation, 0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return instancedVAO;
+    }
+
+    // bind the textures to units 0.. and point the samplers at them
+    void BindTextures(Shader& shader)
+    {
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            shader.setInt(samplerNames[i], i); // 󶨵ֻiidûʲôϵɫֵsampler2D˳ҲûʲôϵΪֻϱҪעiҪǰglActiveTextureӦ
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+private:
+    // render data 
+    unsigned int VBO, EBO;
+    // sampler uniform of each texture (texture_diffuseN, texture_specularN, ...), resolved once here instead of every Draw
+    vector<UniformID> samplerNames;
+
+    void setupSamplerNames()
+    {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr = 1;
         unsigned int heightNr = 1;
         for (unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -76,25 +139,10 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to string
             else if (name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i); // 󶨵ֻiidûʲôϵɫֵsampler2D˳ҲûʲôϵΪֻϱҪעiҪǰglActiveTextureӦ
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerNames.push_back(UniformID(name + number));
         }
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -115,6 +163,16 @@ private:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
+        setupVertexAttributes();
+        glBindVertexArray(0);
+    }
+
+    // vertex attributes 0-6 of the bound VAO from VBO and the indices from EBO (for VAO and the instanced VAOs)
+    void setupVertexAttributes()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
         // set the vertex attribute pointers
         // vertex Positions
         glEnableVertexAttribArray(0);
@@ -138,6 +196,5 @@ private:
         // weights
         glEnableVertexAttribArray(6);
         glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
     }
 };
\ No newline at end of file
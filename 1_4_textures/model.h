@@ -11,6 +11,7 @@
 
 #include "mesh.h"
 #include "shader_s.h"
+#include "frustum.h"
 
 #include <string>
 #include <fstream>
@@ -46,7 +47,125 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // sphere around all vertices in model space (centred on their bounding box), for culling
+    BoundingSphere GetBoundingSphere() const
+    {
+        glm::vec3 lo(1e30f), hi(-1e30f);
+        for (const Mesh& mesh : meshes)
+            for (const Vertex& vertex : mesh.vertices) {
+                lo = glm::min(lo, vertex.Position);
+                hi = glm::max(hi, vertex.Position);
+            }
+
+        BoundingSphere sphere;
+        if (lo.x > hi.x)
+            return sphere; // no vertices
+        sphere.center = (lo + hi) * 0.5f;
+        for (const Mesh& mesh : meshes)
+            for (const Vertex& vertex : mesh.vertices)
+                sphere.radius = glm::max(sphere.radius, glm::length(vertex.Position - sphere.center));
+        return sphere;
+    }
+
+    // distance from 'center' to the nearest vertex: a closed, roughly convex model contains a
+    // sphere of about this radius (a little less, the faces between the vertices dip inwards)
+    float GetInnerRadius(const glm::vec3& center) const
+    {
+        float radius = 1e30f;
+        for (const Mesh& mesh : meshes)
+            for (const Vertex& vertex : mesh.vertices)
+                radius = glm::min(radius, glm::length(vertex.Position - center));
+        return radius < 1e30f ? radius : 0.0f;
+    }
+
+    // Instancing. An attached instance buffer gets one VAO per mesh, created once: the mesh's
+    // vertex attributes (0-6) plus the instance attributes of 'format' from
+    // InstanceAttributeLocation on. Several buffers can be attached at the same time (a per-frame
+    // stream, a GPU culling output, ...); each draw only re-points the instance attributes when
+    // 'first' changed since the last draw from that buffer.
+    void AttachInstanceBuffer(unsigned int instanceBuffer, InstanceFormat format)
+    {
+        if (FindInstanceAttachment(instanceBuffer) != nullptr)
+            DetachInstanceBuffer(instanceBuffer);
+        InstanceAttachment attachment;
+        attachment.buffer = instanceBuffer;
+        attachment.format = format;
+        for (Mesh& mesh : meshes) {
+            attachment.vaos.push_back(mesh.CreateInstancedVAO(instanceBuffer, format));
+            attachment.first.push_back(0);
+        }
+        instanceAttachments.push_back(attachment);
+    }
+
+    void DetachInstanceBuffer(unsigned int instanceBuffer)
+    {
+        for (size_t i = 0; i < instanceAttachments.size(); i++)
+            if (instanceAttachments[i].buffer == instanceBuffer) {
+                glDeleteVertexArrays((GLsizei)instanceAttachments[i].vaos.size(), instanceAttachments[i].vaos.data());
+                instanceAttachments.erase(instanceAttachments.begin() + i);
+                return;
+            }
+    }
+
+    // draws instances first .. first + count - 1 of an attached buffer, every mesh with its own textures
+    void DrawInstanced(Shader& shader, unsigned int instanceBuffer, size_t count, size_t first = 0)
+    {
+        InstanceAttachment* attachment = FindInstanceAttachment(instanceBuffer);
+        if (attachment == nullptr) {
+            cout << "ERROR::MODEL:: DrawInstanced from instance buffer " << instanceBuffer << ", which is not attached" << endl;
+            return;
+        }
+        if (count == 0)
+            return;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            PointInstances(*attachment, i, first);
+            meshes[i].DrawInstanced(shader, attachment->vaos[i], (GLsizei)count);
+        }
+    }
+
+    // for instanced draws the caller issues itself (indirect draws): binds the textures of mesh
+    // 'meshIndex' and its VAO for 'instanceBuffer', starting at instance 'first'
+    void BindInstanced(Shader& shader, size_t meshIndex, unsigned int instanceBuffer, size_t first = 0)
+    {
+        InstanceAttachment* attachment = FindInstanceAttachment(instanceBuffer);
+        if (attachment == nullptr) {
+            cout << "ERROR::MODEL:: BindInstanced to instance buffer " << instanceBuffer << ", which is not attached" << endl;
+            return;
+        }
+        PointInstances(*attachment, meshIndex, first);
+        meshes[meshIndex].BindTextures(shader);
+        glBindVertexArray(attachment->vaos[meshIndex]);
+    }
+
 private:
+    struct InstanceAttachment {
+        unsigned int buffer = 0;
+        InstanceFormat format = InstanceFormat::Matrix;
+        vector<unsigned int> vaos;   // one per mesh
+        vector<size_t> first;        // instance the attributes of each VAO point at
+    };
+    vector<InstanceAttachment> instanceAttachments;
+
+    InstanceAttachment* FindInstanceAttachment(unsigned int instanceBuffer)
+    {
+        for (InstanceAttachment& attachment : instanceAttachments)
+            if (attachment.buffer == instanceBuffer)
+                return &attachment;
+        return nullptr;
+    }
+
+    void PointInstances(InstanceAttachment& attachment, size_t meshIndex, size_t first)
+    {
+        if (attachment.first[meshIndex] == first)
+            return;
+        glBindVertexArray(attachment.vaos[meshIndex]);
+        glBindBuffer(GL_ARRAY_BUFFER, attachment.buffer);
+        setInstanceAttributes(attachment.format, InstanceAttributeLocation, (GLintptr)(first * instanceStride(attachment.format)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        attachment.first[meshIndex] = first;
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path)
     {
@@ -0,0 +1,347 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define OCCLUSION_BUFFER_SSE 1
+#endif
+
+// Occlusion culling on the CPU: a few large occluders (low-poly proxies that lie inside the real
+// meshes) are rasterized into a small depth buffer, which is reduced into a hierarchical-Z pyramid
+// that instance bounds are tested against before anything is submitted to the GPU.
+//
+//  - render(): occluder triangles are transformed and binned into 32x32 pixel tiles, then every
+//    tile is cleared and rasterized on the ThreadPool (edge functions, 4 pixels per SSE step,
+//    keeping the nearest depth). Triangles crossing the near plane are dropped, which only
+//    loses occlusion. Back faces are skipped: the front faces of a closed occluder hide the same.
+//  - The pyramid keeps the farthest depth of every 2x2 block. A sphere is occluded if its nearest
+//    point is behind the farthest occluder depth over its screen rectangle; the level is picked so
+//    the rectangle covers at most 2x2 texels.
+//
+// Depth is the window depth of a glm::perspective projection (symmetric frustum), so it compares
+// directly with the depth of the rasterized occluders. Everything is plain CPU code: it also runs
+// (and can be checked) without a GPU.
+//
+//     occlusion.addOccluder(vertices, indices, model);       // once
+//     occlusion.render(view, projection, nearPlane, pool);   // every frame, before culling
+//     if (occlusion.sphereOccluded(center, radius)) ...      // from any thread
+class OcclusionBuffer {
+public:
+    struct Stats {
+        size_t triangles = 0;    // front-facing triangles rasterized in the last render()
+        double renderMs = 0.0;   // transform + raster + pyramid
+    };
+
+    OcclusionBuffer(int width = 256, int height = 128) {
+        resize(width, height);
+    }
+
+    // a new size (e.g. for the aspect ratio of a resized window); the occluders are kept, the
+    // depth is empty until the next render()
+    void resize(int width, int height) {
+        width = (width + 3) & ~3;
+        height = std::max(1, height);
+        if (width == bufferWidth && height == bufferHeight)
+            return;
+        bufferWidth = width;
+        bufferHeight = height;
+        levels.clear();
+        int w = bufferWidth, h = bufferHeight;
+        for (;;) {
+            levels.push_back(Level{ w, h, std::vector<float>((size_t)w * h, 1.0f) });
+            if (w == 1 && h == 1)
+                break;
+            w = std::max(1, (w + 1) / 2);
+            h = std::max(1, (h + 1) / 2);
+        }
+        tilesX = (bufferWidth + TileSize - 1) / TileSize;
+        tilesY = (bufferHeight + TileSize - 1) / TileSize;
+        tileTriangles.assign((size_t)tilesX * tilesY, std::vector<uint32_t>());
+    }
+
+    int width() const {
+        return bufferWidth;
+    }
+
+    int height() const {
+        return bufferHeight;
+    }
+
+    // level 0 of the pyramid, row 0 at the bottom of the screen; 1 = nothing
+    const std::vector<float>& depth() const {
+        return levels[0].depth;
+    }
+
+    const Stats& stats() const {
+        return lastStats;
+    }
+
+    void clearOccluders() {
+        occluderVertices.clear();
+        occluderIndices.clear();
+    }
+
+    // triangles (counter-clockwise when seen from outside) transformed by 'model'; they must not
+    // reach outside the object they stand for
+    void addOccluder(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, const glm::mat4& model) {
+        uint32_t base = (uint32_t)occluderVertices.size();
+        for (const glm::vec3& v : vertices)
+            occluderVertices.push_back(glm::vec3(model * glm::vec4(v, 1.0f)));
+        for (uint32_t index : indices)
+            occluderIndices.push_back(base + index);
+    }
+
+    // UV sphere with its vertices on 'radius', so every face lies inside the sphere
+    static void sphereMesh(unsigned int segments, unsigned int rings, float radius,
+        std::vector<glm::vec3>& vertices, std::vector<uint32_t>& indices) {
+        vertices.clear();
+        indices.clear();
+        for (unsigned int ring = 0; ring <= rings; ring++) {
+            float phi = glm::pi<float>() * ring / rings;
+            for (unsigned int segment = 0; segment <= segments; segment++) {
+                float theta = glm::two_pi<float>() * segment / segments;
+                vertices.push_back(radius * glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), -std::sin(phi) * std::sin(theta)));
+            }
+        }
+        for (unsigned int ring = 0; ring < rings; ring++)
+            for (unsigned int segment = 0; segment < segments; segment++) {
+                uint32_t a = ring * (segments + 1) + segment, b = a + segments + 1;
+                uint32_t quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+    }
+
+    // rasterize the occluders for this camera and rebuild the pyramid
+    void render(const glm::mat4& view, const glm::mat4& projection, float nearPlane, ThreadPool& pool) {
+        auto start = std::chrono::steady_clock::now();
+        this->view = view;
+        this->nearPlane = nearPlane;
+        depthScale = projection[2][2];
+        depthOffset = projection[3][2];
+        xScale = projection[0][0];
+        yScale = projection[1][1];
+
+        setupTriangles(projection * view);
+
+        pool.parallelFor(tileTriangles.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t tile = begin; tile < end; tile++)
+                rasterizeTile((int)tile);
+        });
+
+        for (size_t level = 1; level < levels.size(); level++)
+            reduce(levels[level - 1], levels[level]);
+
+        lastStats.triangles = triangles.size();
+        lastStats.renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // true if the whole sphere is hidden behind the occluders; false for anything partly in
+    // front of the near plane or off screen (that is frustum culling's job)
+    bool sphereOccluded(const glm::vec3& center, float radius) const {
+        glm::vec3 c = glm::vec3(view * glm::vec4(center, 1.0f));
+        float nearest = -c.z - radius;
+        float farthest = -c.z + radius;
+        if (nearest <= nearPlane)
+            return false;
+
+        // the view-space box around the sphere, projected: its corners at both depths
+        float xMin = std::min((c.x - radius) / nearest, (c.x - radius) / farthest) * xScale;
+        float xMax = std::max((c.x + radius) / nearest, (c.x + radius) / farthest) * xScale;
+        float yMin = std::min((c.y - radius) / nearest, (c.y - radius) / farthest) * yScale;
+        float yMax = std::max((c.y + radius) / nearest, (c.y + radius) / farthest) * yScale;
+        if (xMax < -1.0f || xMin > 1.0f || yMax < -1.0f || yMin > 1.0f)
+            return false;
+
+        // one texel more on every side: occluders are only written where they cover a texel's
+        // centre, so a silhouette crossing the rectangle's edge texels must still be seen
+        int x0 = std::max(0, (int)std::floor((xMin * 0.5f + 0.5f) * bufferWidth) - 1);
+        int x1 = std::min(bufferWidth - 1, (int)std::floor((xMax * 0.5f + 0.5f) * bufferWidth) + 1);
+        int y0 = std::max(0, (int)std::floor((yMin * 0.5f + 0.5f) * bufferHeight) - 1);
+        int y1 = std::min(bufferHeight - 1, (int)std::floor((yMax * 0.5f + 0.5f) * bufferHeight) + 1);
+
+        size_t level = 0;
+        while (level + 1 < levels.size() && std::max(x1 - x0, y1 - y0) >= 2) {
+            x0 >>= 1;
+            x1 >>= 1;
+            y0 >>= 1;
+            y1 >>= 1;
+            level++;
+        }
+
+        const Level& l = levels[level];
+        float occluderDepth = 0.0f;
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                occluderDepth = std::max(occluderDepth, l.depth[(size_t)y * l.width + x]);
+        return windowDepth(nearest) > occluderDepth;
+    }
+
+    // an axis-aligned box, tested through its bounding sphere
+    bool boxOccluded(const glm::vec3& min, const glm::vec3& max) const {
+        return sphereOccluded((min + max) * 0.5f, glm::length(max - min) * 0.5f);
+    }
+
+private:
+    static const int TileSize = 32;   // pixels, a multiple of 4
+
+    struct Level {
+        int width;
+        int height;
+        std::vector<float> depth;
+    };
+
+    // screen-space triangle: edge functions e = a * x + b * y + c (>= 0 inside) and a depth plane
+    struct Triangle {
+        float a[3], b[3], c[3];
+        float z0, dzdx, dzdy;        // depth = z0 + dzdx * x + dzdy * y
+        int xMin, xMax, yMin, yMax;  // pixel bounds, clamped to the screen
+    };
+
+    int bufferWidth = 0;
+    int bufferHeight = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    std::vector<Level> levels;
+    std::vector<glm::vec3> occluderVertices;   // world space
+    std::vector<uint32_t> occluderIndices;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<uint32_t>> tileTriangles;
+    glm::mat4 view = glm::mat4(1.0f);
+    float nearPlane = 0.1f;
+    float depthScale = 0.0f, depthOffset = 0.0f, xScale = 1.0f, yScale = 1.0f;
+    Stats lastStats;
+
+    // window depth of a point 'distance' in front of the camera
+    float windowDepth(float distance) const {
+        return (depthScale * -distance + depthOffset) / distance * 0.5f + 0.5f;
+    }
+
+    void setupTriangles(const glm::mat4& viewProjection) {
+        std::vector<glm::vec4> clip(occluderVertices.size());
+        for (size_t i = 0; i < occluderVertices.size(); i++)
+            clip[i] = viewProjection * glm::vec4(occluderVertices[i], 1.0f);
+
+        triangles.clear();
+        for (auto& list : tileTriangles)
+            list.clear();
+
+        for (size_t i = 0; i + 2 < occluderIndices.size(); i += 3) {
+            glm::vec3 p[3];
+            bool behind = false;
+            for (int k = 0; k < 3; k++) {
+                const glm::vec4& v = clip[occluderIndices[i + k]];
+                if (v.w <= nearPlane) {
+                    behind = true;
+                    break;
+                }
+                p[k] = glm::vec3((v.x / v.w * 0.5f + 0.5f) * bufferWidth, (v.y / v.w * 0.5f + 0.5f) * bufferHeight, v.z / v.w * 0.5f + 0.5f);
+            }
+            if (behind)
+                continue;
+
+            float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+            if (area <= 0.0f)
+                continue; // back facing or degenerate
+
+            Triangle t;
+            t.xMin = std::max(0, (int)std::floor(std::min(p[0].x, std::min(p[1].x, p[2].x))));
+            t.xMax = std::min(bufferWidth - 1, (int)std::ceil(std::max(p[0].x, std::max(p[1].x, p[2].x))));
+            t.yMin = std::max(0, (int)std::floor(std::min(p[0].y, std::min(p[1].y, p[2].y))));
+            t.yMax = std::min(bufferHeight - 1, (int)std::ceil(std::max(p[0].y, std::max(p[1].y, p[2].y))));
+            if (t.xMin > t.xMax || t.yMin > t.yMax)
+                continue;
+
+            for (int k = 0; k < 3; k++) {
+                const glm::vec3& from = p[(k + 1) % 3];
+                const glm::vec3& to = p[(k + 2) % 3];
+                t.a[k] = from.y - to.y;
+                t.b[k] = to.x - from.x;
+                t.c[k] = from.x * to.y - from.y * to.x;
+            }
+            // the edge function opposite vertex k is area * barycentric k
+            float inverseArea = 1.0f / area;
+            t.dzdx = (t.a[0] * p[0].z + t.a[1] * p[1].z + t.a[2] * p[2].z) * inverseArea;
+            t.dzdy = (t.b[0] * p[0].z + t.b[1] * p[1].z + t.b[2] * p[2].z) * inverseArea;
+            t.z0 = (t.c[0] * p[0].z + t.c[1] * p[1].z + t.c[2] * p[2].z) * inverseArea;
+
+            uint32_t index = (uint32_t)triangles.size();
+            triangles.push_back(t);
+            for (int ty = t.yMin / TileSize; ty <= t.yMax / TileSize; ty++)
+                for (int tx = t.xMin / TileSize; tx <= t.xMax / TileSize; tx++)
+                    tileTriangles[(size_t)ty * tilesX + tx].push_back(index);
+        }
+    }
+
+    void rasterizeTile(int tile) {
+        int tileX0 = (tile % tilesX) * TileSize, tileY0 = (tile / tilesX) * TileSize;
+        int tileX1 = std::min(tileX0 + TileSize, bufferWidth) - 1, tileY1 = std::min(tileY0 + TileSize, bufferHeight) - 1;
+        std::vector<float>& depth = levels[0].depth;
+        for (int y = tileY0; y <= tileY1; y++)
+            std::fill(depth.begin() + (size_t)y * bufferWidth + tileX0, depth.begin() + (size_t)y * bufferWidth + tileX1 + 1, 1.0f);
+
+        for (uint32_t index : tileTriangles[tile]) {
+            const Triangle& t = triangles[index];
+            int x0 = std::max(t.xMin, tileX0) & ~3; // whole groups of 4, inside the tile (bufferWidth is a multiple of 4)
+            int x1 = std::min(t.xMax, tileX1);
+            int y0 = std::max(t.yMin, tileY0), y1 = std::min(t.yMax, tileY1);
+            for (int y = y0; y <= y1; y++) {
+                float py = y + 0.5f;
+                float* row = &depth[(size_t)y * bufferWidth];
+#ifdef OCCLUSION_BUFFER_SSE
+                __m128 e0Row = _mm_set1_ps(t.b[0] * py + t.c[0]);
+                __m128 e1Row = _mm_set1_ps(t.b[1] * py + t.c[1]);
+                __m128 e2Row = _mm_set1_ps(t.b[2] * py + t.c[2]);
+                __m128 zRow = _mm_set1_ps(t.z0 + t.dzdy * py);
+                __m128 a0 = _mm_set1_ps(t.a[0]), a1 = _mm_set1_ps(t.a[1]), a2 = _mm_set1_ps(t.a[2]), dzdx = _mm_set1_ps(t.dzdx);
+                const __m128 zero = _mm_setzero_ps();
+                for (int x = x0; x <= x1; x += 4) {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                    __m128 inside = _mm_and_ps(_mm_and_ps(
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), e0Row), zero),
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), e1Row), zero)),
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), e2Row), zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+                    __m128 z = _mm_add_ps(_mm_mul_ps(dzdx, px), zRow);
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(old, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+                }
+#else
+                for (int x = x0; x <= x1; x++) {
+                    float px = x + 0.5f;
+                    if (t.a[0] * px + t.b[0] * py + t.c[0] >= 0.0f && t.a[1] * px + t.b[1] * py + t.c[1] >= 0.0f &&
+                        t.a[2] * px + t.b[2] * py + t.c[2] >= 0.0f)
+                        row[x] = std::min(row[x], t.z0 + t.dzdx * px + t.dzdy * py);
+                }
+#endif
+            }
+        }
+    }
+
+    // every texel of 'to' keeps the farthest of the (up to) 2x2 texels of 'from' it covers
+    static void reduce(const Level& from, Level& to) {
+        for (int y = 0; y < to.height; y++)
+            for (int x = 0; x < to.width; x++) {
+                int fx = x * 2, fy = y * 2;
+                float d = from.depth[(size_t)fy * from.width + fx];
+                if (fx + 1 < from.width)
+                    d = std::max(d, from.depth[(size_t)fy * from.width + fx + 1]);
+                if (fy + 1 < from.height) {
+                    d = std::max(d, from.depth[(size_t)(fy + 1) * from.width + fx]);
+                    if (fx + 1 < from.width)
+                        d = std::max(d, from.depth[(size_t)(fy + 1) * from.width + fx + 1]);
+                }
+                to.depth[(size_t)y * to.width + x] = d;
+            }
+    }
+};
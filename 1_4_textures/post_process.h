@@ -0,0 +1,271 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "render_target_pool.h"
+#include "shader_compile_queue.h"
+#include "shader_preprocessor.h"
+#include "shader_s.h"
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// One node of a post-processing chain, as GLSL.
+//  PerPixel      the new color depends only on the color of the same pixel:
+//                  vec3 NAME(vec3 color) { BODY }
+//  Neighborhood  the new color reads the input around the pixel through fetch(uv), which returns
+//                the input color with every effect before this one applied; texelSize is the
+//                size of one input pixel in uv units:
+//                  vec3 NAME(vec2 uv) { BODY }
+//  Filter        runs passes of its own (blur_filters.h): reads 'input' (inputWidth x inputHeight:
+//                the scene size at the head of the chain, else screen sized), draws into the
+//                screen sized 'outputFbo' with the full-screen quad that is bound, and takes its
+//                intermediate targets from the pool
+struct PostEffect {
+    enum Kind {
+        PerPixel,
+        Neighborhood,
+        Filter,
+    };
+
+    typedef std::function<void(GLuint input, int inputWidth, int inputHeight, GLuint outputFbo, RenderTargetPool& pool,
+        const RenderTargetDesc& intermediate)> FilterFunction;
+
+    std::string name;   // also the GLSL function name
+    Kind kind = PerPixel;
+    std::string body;
+    FilterFunction filter;
+
+    // invert, grayscale, sharpen, edge, blur (3x3 kernels); false for other names
+    static bool builtin(const std::string& name, PostEffect& effect) {
+        effect.name = name;
+        if (name == "invert") {
+            effect.kind = PerPixel;
+            effect.body = "return 1.0 - color;";
+        }
+        else if (name == "grayscale") {
+            effect.kind = PerPixel;
+            effect.body = "return vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));";
+        }
+        else if (name == "sharpen")
+            kernel3x3(effect, "-1.0, -1.0, -1.0,  -1.0, 9.0, -1.0,  -1.0, -1.0, -1.0");
+        else if (name == "edge")
+            kernel3x3(effect, "1.0, 1.0, 1.0,  1.0, -8.0, 1.0,  1.0, 1.0, 1.0");
+        else if (name == "blur")
+            kernel3x3(effect, "1.0 / 16, 2.0 / 16, 1.0 / 16,  2.0 / 16, 4.0 / 16, 2.0 / 16,  1.0 / 16, 2.0 / 16, 1.0 / 16");
+        else
+            return false;
+        return true;
+    }
+
+    // "invert,blur,grayscale" -> built-in effects (or 'extra' ones, e.g. filters, by name) in that
+    // order; on an unknown name returns false with it in 'unknown'
+    static bool parseList(const std::string& list, std::vector<PostEffect>& effects, std::string& unknown,
+        const std::vector<PostEffect>& extra = std::vector<PostEffect>()) {
+        effects.clear();
+        std::stringstream in(list);
+        std::string name;
+        while (std::getline(in, name, ',')) {
+            if (name.empty() || name == "none")
+                continue;
+            PostEffect effect;
+            auto named = std::find_if(extra.begin(), extra.end(), [&](const PostEffect& e) { return e.name == name; });
+            if (named != extra.end())
+                effect = *named;
+            else if (!builtin(name, effect)) {
+                unknown = name;
+                return false;
+            }
+            effects.push_back(effect);
+        }
+        return true;
+    }
+
+private:
+    static void kernel3x3(PostEffect& effect, const char* weights) {
+        effect.kind = Neighborhood;
+        effect.body = std::string("const float kernel[9] = float[](") + weights + ");\n"
+            "    vec3 sum = vec3(0.0);\n"
+            "    for (int i = 0; i < 9; i++)\n"
+            "        sum += kernel[i] * fetch(uv + vec2(i % 3 - 1, 1 - i / 3) * texelSize);\n"
+            "    return sum;";
+    }
+};
+
+// A chain of post effects, drawn with as few full-screen passes as the chain allows.
+//
+// Per-pixel effects never need a pass of their own: the ones after a neighborhood effect run at the
+// end of its pass, and the ones before the first neighborhood effect run inside its fetch(), once
+// per tap (a few ALU operations per tap are far cheaper than writing and reading back a
+// full-screen target). Only a neighborhood effect that reads the result of an earlier
+// neighborhood effect starts a new pass, so a chain costs max(1, neighborhood effects) passes.
+// A filter node runs on its own between the passes before and after it.
+// Every other pass is one generated fragment shader; the passes between the input and the output
+// render into ping-pong targets from the RenderTargetPool (two at most, released as soon as the
+// next pass has read them).
+//
+//     PostProcessChain post(queue, effects, "post.vs");   // post.vs: the full-screen quad, TexCoords out
+//     post.apply(sceneTexture, width, height, pool, intermediateDesc, quadVAO, 0);
+class PostProcessChain {
+public:
+    PostProcessChain(ShaderCompileQueue& queue, const std::vector<PostEffect>& effects, const char* quadVertexPath) : effects(effects) {
+        plan();
+        std::string vertex = ShaderPreprocessor::process(quadVertexPath);
+        for (Pass& pass : passes) {
+            if (isFilter(pass))
+                continue;
+            ShaderSources sources;
+            sources.vertex = vertex;
+            sources.fragment = fragmentSource(pass);
+            pass.shader = &queue.add(sources);
+        }
+    }
+
+    size_t passCount() const {
+        return passes.size();
+    }
+
+    // no effects: apply() only copies (or upscales) the input
+    bool empty() const {
+        return effects.empty();
+    }
+
+    // e.g. "invert > blur | grayscale" per pass, passes separated by " / " ("copy" for an empty chain)
+    std::string describe() const {
+        std::string out;
+        for (const Pass& pass : passes) {
+            if (!out.empty())
+                out += " / ";
+            std::string text;
+            for (size_t i = pass.first; i < pass.first + pass.count; i++)
+                text += (text.empty() ? "" : (effects[i].kind == PostEffect::Neighborhood ? " > " : " | ")) + effects[i].name;
+            out += text.empty() ? "copy" : text;
+        }
+        return out;
+    }
+
+    // read 'input' (a GL_TEXTURE_2D of inputWidth x inputHeight; when smaller than the pool's size
+    // the first pass upscales it bilinearly) and draw the chain into 'outputFbo', screen sized;
+    // leaves depth testing off and quadVAO bound
+    void apply(GLuint input, int inputWidth, int inputHeight, RenderTargetPool& pool, const RenderTargetDesc& intermediate, GLuint quadVAO, GLuint outputFbo) {
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(quadVAO);
+        glActiveTexture(GL_TEXTURE0);
+        RenderTarget* previous = nullptr;
+        GLuint source = input;
+        for (size_t i = 0; i < passes.size(); i++) {
+            RenderTarget* target = i + 1 < passes.size() ? pool.acquire(intermediate) : nullptr;
+            // a texel of what the pass reads: the input, then screen sized targets
+            int sourceWidth = i == 0 ? inputWidth : pool.width(), sourceHeight = i == 0 ? inputHeight : pool.height();
+            if (isFilter(passes[i]))
+                effects[passes[i].first].filter(source, sourceWidth, sourceHeight, target ? target->fbo : outputFbo, pool, intermediate);
+            else {
+                glBindFramebuffer(GL_FRAMEBUFFER, target ? target->fbo : outputFbo);
+                glViewport(0, 0, pool.width(), pool.height());
+                Shader& shader = *passes[i].shader;
+                shader.use();
+                shader.setInt("screenTexture", 0);
+                shader.setVec2("texelSize", 1.0f / sourceWidth, 1.0f / sourceHeight);
+                glBindTexture(GL_TEXTURE_2D, source);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+
+            if (previous)
+                pool.release(previous);
+            previous = target;
+            source = target ? target->color : 0;
+        }
+    }
+
+private:
+    // effects [first, first + count): per-pixel effects, at most one neighborhood effect, per-pixel
+    // effects; or a single filter
+    struct Pass {
+        size_t first = 0;
+        size_t count = 0;
+        Shader* shader = nullptr;
+    };
+
+    std::vector<PostEffect> effects;
+    std::vector<Pass> passes;
+
+    bool isFilter(const Pass& pass) const {
+        return pass.count == 1 && effects[pass.first].kind == PostEffect::Filter;
+    }
+
+    // cut the chain before every neighborhood effect but the first, and around every filter
+    void plan() {
+        Pass pass;
+        bool hasNeighborhood = false;
+        for (size_t i = 0; i < effects.size(); i++) {
+            if (effects[i].kind == PostEffect::Filter) {
+                if (pass.count > 0)
+                    passes.push_back(pass);
+                Pass filter;
+                filter.first = i;
+                filter.count = 1;
+                passes.push_back(filter);
+                pass.first = i + 1;
+                pass.count = 0;
+                hasNeighborhood = false;
+                continue;
+            }
+            if (effects[i].kind == PostEffect::Neighborhood) {
+                if (hasNeighborhood) {
+                    passes.push_back(pass);
+                    pass.first = i;
+                    pass.count = 0;
+                }
+                hasNeighborhood = true;
+            }
+            pass.count++;
+        }
+        if (pass.count > 0 || passes.empty())
+            passes.push_back(pass);
+    }
+
+    std::string fragmentSource(const Pass& pass) const {
+        std::string functions, fetch, main;
+        const PostEffect* neighborhood = nullptr;
+        for (size_t i = pass.first; i < pass.first + pass.count; i++) {
+            const PostEffect& effect = effects[i];
+            bool defined = false;
+            for (size_t j = pass.first; j < i; j++)
+                defined = defined || effects[j].name == effect.name;
+            if (effect.kind == PostEffect::Neighborhood)
+                neighborhood = &effect;
+            else {
+                if (!defined)
+                    functions += "vec3 " + effect.name + "(vec3 color)\n{\n    " + effect.body + "\n}\n\n";
+                (neighborhood ? main : fetch) += "    color = " + effect.name + "(color);\n";
+            }
+        }
+
+        std::string source =
+            "#version 330 core\n"
+            "out vec4 FragColor;\n"
+            "\n"
+            "in vec2 TexCoords;\n"
+            "\n"
+            "uniform sampler2D screenTexture;\n"
+            "uniform vec2 texelSize;\n"
+            "\n" + functions +
+            "vec3 fetch(vec2 uv)\n"
+            "{\n"
+            "    vec3 color = texture(screenTexture, uv).rgb;\n" + fetch +
+            "    return color;\n"
+            "}\n"
+            "\n";
+        if (neighborhood)
+            source += "vec3 " + neighborhood->name + "(vec2 uv)\n{\n    " + neighborhood->body + "\n}\n\n";
+        source +=
+            "void main()\n"
+            "{\n"
+            "    vec3 color = " + (neighborhood ? neighborhood->name + "(TexCoords)" : std::string("fetch(TexCoords)")) + ";\n" + main +
+            "    FragColor = vec4(color, 1.0);\n"
+            "}\n";
+        return source;
+    }
+};
@@ -0,0 +1,205 @@
+#pragma once
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// one rung of the quality ladder
+struct QualityLevel {
+    float renderScale = 1.0f;   // of the framebuffer size, per axis; the final post pass upscales
+    int msaaSamples = 4;        // 0 = no multisampling
+    float lodBias = 1.0f;       // multiplies the LOD pixel thresholds (larger = impostors sooner)
+};
+
+// when the governor moves
+struct QualityGovernorSettings {
+    double targetMs = 1000.0 / 60.0;
+    unsigned int windowFrames = 30;   // frames with a GPU time per decision
+    double downRatio = 1.05;          // over targetMs * downRatio: one rung down
+    double upRatio = 0.80;            // under targetMs * upRatio for upWindows windows in a row: one rung up
+    unsigned int upWindows = 3;
+};
+
+// Holds a frame time by trading image quality for speed: a ladder of levels (render scale, MSAA
+// samples, LOD bias) from the best to the cheapest, one rung at a time.
+//
+// Frame cost is the larger of the average CPU and GPU time over a window of frames. GPU times
+// arrive a few frames late, so after every change the times of frames rendered before it are
+// ignored and the window starts over. Hysteresis: the governor steps down as soon as a window is
+// over targetMs * downRatio, but up only after upWindows windows under targetMs * upRatio, and
+// only if the GPU time scaled by the pixel count of the better level would still fit. A level
+// that had to be left again in the first window after stepping up to it doubles the number of
+// windows needed before the next try (up to 8x), so a level just over the budget is not
+// re-entered every second. Every decision (including a raise held back) is printed and kept for
+// writeCsv().
+//
+//     QualityGovernor governor(settings);
+//     governor.cpu(frame, cpuMs);  governor.gpu(frame, gpuMs);   // as the times come in
+//     if (governor.update(frame))  apply(governor.level());       // before rendering the frame
+class QualityGovernor {
+public:
+    struct Decision {
+        unsigned long long frame;
+        double cpuMs;
+        double gpuMs;
+        size_t from;
+        size_t to;
+        std::string reason;
+    };
+
+    explicit QualityGovernor(const QualityGovernorSettings& settings, const std::vector<QualityLevel>& ladder = defaultLadder())
+        : settings(settings), ladder(ladder.empty() ? defaultLadder() : ladder) {
+    }
+
+    // 100% 4x, 100% 2x, 85% 2x, 75% 2x, 75% no MSAA, 60%, 50%; the LOD bias rises from 75% on
+    static std::vector<QualityLevel> defaultLadder() {
+        const QualityLevel levels[] = {
+            { 1.00f, 4, 1.0f },
+            { 1.00f, 2, 1.0f },
+            { 0.85f, 2, 1.0f },
+            { 0.75f, 2, 1.25f },
+            { 0.75f, 0, 1.5f },
+            { 0.60f, 0, 2.0f },
+            { 0.50f, 0, 2.5f },
+        };
+        return std::vector<QualityLevel>(std::begin(levels), std::end(levels));
+    }
+
+    const QualityLevel& level() const {
+        return ladder[current];
+    }
+
+    size_t levelIndex() const {
+        return current;
+    }
+
+    size_t levelCount() const {
+        return ladder.size();
+    }
+
+    void cpu(unsigned long long frame, double ms) {
+        if (frame < windowStart)
+            return;
+        cpuSum += ms;
+        cpuFrames++;
+    }
+
+    void gpu(unsigned long long frame, double ms) {
+        if (frame < windowStart)
+            return;
+        gpuSum += ms;
+        gpuFrames++;
+    }
+
+    // once per frame, before rendering 'frame'; true if level() changed
+    bool update(unsigned long long frame) {
+        if (gpuFrames < settings.windowFrames || cpuFrames == 0)
+            return false;
+        double cpuMs = cpuSum / cpuFrames, gpuMs = gpuSum / gpuFrames;
+        double cost = std::max(cpuMs, gpuMs);
+        bool justRaised = windowsSinceRaise == 0;
+        windowsSinceRaise++;
+        clearWindow();
+
+        if (cost > settings.targetMs * settings.downRatio && current + 1 < ladder.size()) {
+            if (justRaised)
+                raiseDelay = std::min(raiseDelay * 2, 8u);
+            underWindows = 0;
+            return change(frame, cpuMs, gpuMs, current + 1, justRaised ? "over budget right after raising" : "over budget");
+        }
+        if (cost >= settings.targetMs * settings.upRatio || current == 0) {
+            underWindows = 0;
+            return false;
+        }
+        if (++underWindows < settings.upWindows * raiseDelay)
+            return false;
+        double predictedGpuMs = gpuMs * pixels(ladder[current - 1]) / pixels(ladder[current]);
+        if (predictedGpuMs > settings.targetMs * settings.downRatio) {
+            underWindows = 0;
+            std::ostringstream reason;
+            reason << "under budget, but level " << current - 1 << " would take about " << std::fixed << std::setprecision(2) << predictedGpuMs << " ms on the GPU";
+            record(frame, cpuMs, gpuMs, current, reason.str());
+            return false;
+        }
+        underWindows = 0;
+        windowsSinceRaise = 0;
+        return change(frame, cpuMs, gpuMs, current - 1, "under budget");
+    }
+
+    const std::vector<Decision>& decisions() const {
+        return log;
+    }
+
+    // one row per decision (changes, and raises held back): frame, window averages, levels and why
+    bool writeCsv(const std::string& path) const {
+        std::ofstream file(path);
+        if (!file) {
+            std::cout << "ERROR::QUALITY_GOVERNOR::FILE_NOT_WRITABLE: " << path << std::endl;
+            return false;
+        }
+        file << "frame,cpu_ms,gpu_ms,target_ms,from,to,render_scale,msaa,lod_bias,reason\n";
+        for (const Decision& d : log) {
+            const QualityLevel& to = ladder[d.to];
+            file << d.frame << "," << d.cpuMs << "," << d.gpuMs << "," << settings.targetMs << "," << d.from << "," << d.to << ","
+                << to.renderScale << "," << to.msaaSamples << "," << to.lodBias << "," << d.reason << "\n";
+        }
+        return true;
+    }
+
+    static std::string describe(const QualityLevel& level) {
+        std::ostringstream out;
+        out << (int)(level.renderScale * 100.0f + 0.5f) << "% resolution, ";
+        if (level.msaaSamples > 0)
+            out << level.msaaSamples << "x MSAA";
+        else
+            out << "no MSAA";
+        out << ", LOD bias " << level.lodBias;
+        return out.str();
+    }
+
+private:
+    QualityGovernorSettings settings;
+    std::vector<QualityLevel> ladder;
+    size_t current = 0;
+    unsigned long long windowStart = 0;   // times of earlier frames are ignored
+    double cpuSum = 0.0, gpuSum = 0.0;
+    unsigned int cpuFrames = 0, gpuFrames = 0;
+    unsigned int underWindows = 0;
+    unsigned int windowsSinceRaise = 1;
+    unsigned int raiseDelay = 1;
+    std::vector<Decision> log;
+
+    static double pixels(const QualityLevel& level) {
+        return (double)level.renderScale * level.renderScale;
+    }
+
+    // the next window; GPU times of frames still in flight count towards it
+    void clearWindow() {
+        cpuSum = gpuSum = 0.0;
+        cpuFrames = gpuFrames = 0;
+    }
+
+    // frames rendered at the old level no longer count, even when their times arrive later
+    bool change(unsigned long long frame, double cpuMs, double gpuMs, size_t to, const std::string& reason) {
+        record(frame, cpuMs, gpuMs, to, reason);
+        current = to;
+        windowStart = frame;
+        clearWindow();
+        return true;
+    }
+
+    // print and keep a decision; to == current when the level stays
+    void record(unsigned long long frame, double cpuMs, double gpuMs, size_t to, const std::string& reason) {
+        Decision d = { frame, cpuMs, gpuMs, current, to, reason };
+        log.push_back(d);
+        // formatted apart, so std::cout keeps its own precision
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2) << "Quality governor: frame " << frame << ", CPU " << cpuMs << " ms / GPU " << gpuMs
+            << " ms against " << settings.targetMs << " ms, " << reason << " -> level " << to << " (" << describe(ladder[to]) << ")";
+        std::cout << line.str() << std::endl;
+    }
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+
+// PCG32 (O'Neill, pcg-random.org): 64-bit state, 32-bit output, and a stream id that selects one
+// of 2^63 independent sequences for the same seed. Much faster than rand(), with no global state,
+// and the same seed always gives the same numbers on every platform.
+//
+// Parallel work splits one seed into per-task generators: Random(seed, task) or split(task).
+// Each task then draws the same numbers however the tasks are spread over threads.
+class Random {
+public:
+    explicit Random(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0xda3e39cb94b95bdbULL) {
+        origin = seed;
+        state = 0;
+        increment = (stream << 1u) | 1u;
+        nextU32();
+        state += seed;
+        nextU32();
+    }
+
+    // an independent generator for sub-task 'stream', derived from this one's seed and stream
+    // (not from its current position, so it does not matter how much was drawn before). The
+    // child's seed is hashed with 'stream' as well, so children differ in their state and not
+    // only in their PCG stream, whose sequences are related for the same seed
+    Random split(uint64_t stream) const {
+        return Random(mix(mix(origin ^ mix(increment)) + stream), stream);
+    }
+
+    uint32_t nextU32() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + increment;
+        uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = (uint32_t)(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+    }
+
+    // [0, 1): the top 24 bits, so every value is exactly representable
+    float nextFloat() {
+        return (nextU32() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // [lo, hi)
+    float uniform(float lo, float hi) {
+        return lo + (hi - lo) * nextFloat();
+    }
+
+    // [0, bound) without modulo bias
+    uint32_t below(uint32_t bound) {
+        uint32_t threshold = (0u - bound) % bound;
+        for (;;) {
+            uint32_t r = nextU32();
+            if (r >= threshold)
+                return r % bound;
+        }
+    }
+
+private:
+    uint64_t state;
+    uint64_t increment;
+    uint64_t origin;   // the seed, for split()
+
+    // splitmix64 finaliser: turns nearby inputs into unrelated seeds
+    static uint64_t mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+};
@@ -0,0 +1,318 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// what a render target holds; the size follows the pool's screen size
+struct RenderTargetDesc {
+    GLenum colorFormat = GL_RGBA8;   // sized internal format, GL_NONE for depth only
+    GLenum depthFormat = GL_NONE;    // e.g. GL_DEPTH24_STENCIL8 (a renderbuffer), GL_NONE for color only
+    int samples = 0;                 // > 0: multisampled (GL_TEXTURE_2D_MULTISAMPLE)
+    int divisor = 1;                 // 2 for half resolution, ... (rounded up)
+    float scale = 1.0f;              // any other fraction of the screen size, e.g. for dynamic resolution (before the divisor)
+    bool sampledDepth = false;       // depth as a GL_TEXTURE_2D that shaders can read (samples == 0 only)
+
+    bool operator==(const RenderTargetDesc& other) const {
+        return colorFormat == other.colorFormat && depthFormat == other.depthFormat && samples == other.samples && divisor == other.divisor
+            && scale == other.scale && sampledDepth == other.sampledDepth;
+    }
+};
+
+struct RenderTarget {
+    RenderTargetDesc desc;
+    int width = 0;
+    int height = 0;
+    GLuint fbo = 0;
+    GLuint color = 0;   // texture, GL_TEXTURE_2D or GL_TEXTURE_2D_MULTISAMPLE; linear filtering, clamped
+    GLuint depth = 0;   // renderbuffer; texture (nearest filtering) with desc.sampledDepth
+};
+
+// Bytes per pixel (per sample) of the formats used for render targets; RGB8 and RGB16F count as
+// padded to four channels, as drivers store them.
+inline size_t renderTargetBytesPerPixel(GLenum format) {
+    switch (format) {
+    case GL_NONE: return 0;
+    case GL_R8: return 1;
+    case GL_RG8: case GL_R16F: return 2;
+    case GL_RGB16F: case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+    case GL_RGBA32F: return 16;
+    default: return 4; // RGB8, RGBA8, RGB10_A2, R11F_G11F_B10F, R32F, RG16F, DEPTH24_STENCIL8, ...
+    }
+}
+
+inline const char* renderTargetFormatName(GLenum format) {
+    switch (format) {
+    case GL_RGBA8: return "rgba8";
+    case GL_RGB10_A2: return "rgb10a2";
+    case GL_R11F_G11F_B10F: return "r11g11b10f";
+    case GL_RGBA16F: return "rgba16f";
+    default: return "other";
+    }
+}
+
+// color formats for intermediate targets: "rgba8", "rgb10a2", "r11g11b10f" (4 bytes, HDR range
+// without alpha) or "rgba16f" (8 bytes); false for anything else
+inline bool parseRenderTargetFormat(const std::string& name, GLenum& format) {
+    if (name == "rgba8")
+        format = GL_RGBA8;
+    else if (name == "rgb10a2")
+        format = GL_RGB10_A2;
+    else if (name == "r11g11b10f")
+        format = GL_R11F_G11F_B10F;
+    else if (name == "rgba16f")
+        format = GL_RGBA16F;
+    else
+        return false;
+    return true;
+}
+
+// true if the back buffer of the default framebuffer stores colors in 'format' (one of the
+// formats above): a blit from a multisampled target into it needs identical formats
+inline bool defaultFramebufferHasFormat(GLenum format) {
+    GLint expected[4];
+    GLint expectedType = GL_UNSIGNED_NORMALIZED;
+    switch (format) {
+    case GL_RGBA8: expected[0] = expected[1] = expected[2] = expected[3] = 8; break;
+    case GL_RGB10_A2: expected[0] = expected[1] = expected[2] = 10; expected[3] = 2; break;
+    case GL_R11F_G11F_B10F: expected[0] = expected[1] = 11; expected[2] = 10; expected[3] = 0; expectedType = GL_FLOAT; break;
+    case GL_RGBA16F: expected[0] = expected[1] = expected[2] = expected[3] = 16; expectedType = GL_FLOAT; break;
+    default: return false;
+    }
+
+    GLint previous = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    const GLenum sizes[4] = { GL_FRAMEBUFFER_ATTACHMENT_RED_SIZE, GL_FRAMEBUFFER_ATTACHMENT_GREEN_SIZE,
+        GL_FRAMEBUFFER_ATTACHMENT_BLUE_SIZE, GL_FRAMEBUFFER_ATTACHMENT_ALPHA_SIZE };
+    bool same = true;
+    for (int i = 0; i < 4; i++) {
+        GLint size = 0;
+        glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, sizes[i], &size);
+        same = same && size == expected[i];
+    }
+    GLint type = 0, encoding = 0;
+    glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &type);
+    glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    return same && type == expectedType && encoding == GL_LINEAR;
+}
+
+// Off-screen render targets (an FBO with its attachments), pooled by (format, depth, samples, size).
+//
+// acquire() hands out a free target with the same description, or creates one; release() gives it
+// back, so passes of one frame that need a target of the same kind one after another share it,
+// and the same targets come back every frame. resize() changes the screen size: free targets of
+// the old size are deleted at once, targets still in use when they are released. Free targets
+// that nobody acquired for keepFrames frames are deleted in endFrame().
+//
+//     pool.resize(framebufferWidth, framebufferHeight);      // every frame, no-op if unchanged
+//     RenderTarget* scene = pool.acquire(sceneDesc);
+//     glBindFramebuffer(GL_FRAMEBUFFER, scene->fbo);  ...
+//     pool.release(scene);
+//     pool.endFrame();
+class RenderTargetPool {
+public:
+    struct Stats {
+        size_t targets = 0;    // alive, in use or free
+        size_t bytes = 0;      // of their attachments
+        size_t created = 0;    // since the pool was made
+        size_t reused = 0;     // acquire() calls served from the pool
+    };
+
+    RenderTargetPool(int width, int height, unsigned int keepFrames = 2) : screenWidth(width), screenHeight(height), keepFrames(keepFrames) {
+    }
+
+    ~RenderTargetPool() {
+        for (auto& slot : slots)
+            destroy(slot->target);
+    }
+
+    RenderTargetPool(const RenderTargetPool&) = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+    // true if the size changed (0 x 0, e.g. a minimized window, is ignored)
+    bool resize(int width, int height) {
+        if (width <= 0 || height <= 0 || (width == screenWidth && height == screenHeight))
+            return false;
+        screenWidth = width;
+        screenHeight = height;
+        collect(false);
+        return true;
+    }
+
+    int width() const {
+        return screenWidth;
+    }
+
+    int height() const {
+        return screenHeight;
+    }
+
+    // size of a target of this description at the current screen size
+    void targetSize(const RenderTargetDesc& desc, int& width, int& height) const {
+        width = ((int)std::ceil(screenWidth * desc.scale) + desc.divisor - 1) / desc.divisor;
+        height = ((int)std::ceil(screenHeight * desc.scale) + desc.divisor - 1) / desc.divisor;
+        width = std::max(width, 1);
+        height = std::max(height, 1);
+    }
+
+    RenderTarget* acquire(const RenderTargetDesc& desc) {
+        int w, h;
+        targetSize(desc, w, h);
+        for (auto& slot : slots)
+            if (!slot->inUse && slot->target.desc == desc && slot->target.width == w && slot->target.height == h) {
+                slot->inUse = true;
+                slot->lastUsed = frame;
+                lastStats.reused++;
+                return &slot->target;
+            }
+
+        std::unique_ptr<Slot> slot(new Slot);
+        create(slot->target, desc, w, h);
+        slot->inUse = true;
+        slot->lastUsed = frame;
+        slots.push_back(std::move(slot));
+        lastStats.created++;
+        return &slots.back()->target;
+    }
+
+    void release(RenderTarget* target) {
+        for (auto& slot : slots)
+            if (&slot->target == target) {
+                slot->inUse = false;
+                slot->lastUsed = frame;
+                break;
+            }
+        collect(false);
+    }
+
+    // once per frame, after the last release()
+    void endFrame() {
+        frame++;
+        collect(true);
+    }
+
+    Stats stats() const {
+        Stats stats = lastStats;
+        stats.targets = slots.size();
+        stats.bytes = 0;
+        for (const auto& slot : slots) {
+            const RenderTarget& t = slot->target;
+            size_t perPixel = renderTargetBytesPerPixel(t.desc.colorFormat) + renderTargetBytesPerPixel(t.desc.depthFormat);
+            stats.bytes += (size_t)t.width * t.height * std::max(t.desc.samples, 1) * perPixel;
+        }
+        return stats;
+    }
+
+private:
+    struct Slot {
+        RenderTarget target;
+        bool inUse = false;
+        unsigned long long lastUsed = 0;
+    };
+
+    int screenWidth;
+    int screenHeight;
+    unsigned int keepFrames;
+    unsigned long long frame = 0;
+    std::vector<std::unique_ptr<Slot>> slots;
+    Stats lastStats;
+
+    // delete free targets of another size (and, with 'idle', those unused for keepFrames frames)
+    void collect(bool idle) {
+        for (size_t i = 0; i < slots.size();) {
+            Slot& slot = *slots[i];
+            int width, height;
+            targetSize(slot.target.desc, width, height);
+            bool stale = slot.target.width != width || slot.target.height != height;
+            if (!slot.inUse && (stale || (idle && slot.lastUsed + keepFrames < frame))) {
+                destroy(slot.target);
+                slots.erase(slots.begin() + i);
+            }
+            else
+                i++;
+        }
+    }
+
+    static void create(RenderTarget& target, const RenderTargetDesc& desc, int width, int height) {
+        target.desc = desc;
+        target.width = width;
+        target.height = height;
+        glGenFramebuffers(1, &target.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+
+        if (desc.colorFormat != GL_NONE) {
+            glGenTextures(1, &target.color);
+            if (desc.samples > 0) {
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.color);
+                glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.colorFormat, width, height, GL_TRUE);
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, target.color, 0);
+            }
+            else {
+                glBindTexture(GL_TEXTURE_2D, target.color);
+                glTexImage2D(GL_TEXTURE_2D, 0, desc.colorFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+            }
+        }
+        else {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+
+        bool stencil = desc.depthFormat == GL_DEPTH24_STENCIL8 || desc.depthFormat == GL_DEPTH32F_STENCIL8;
+        GLenum depthAttachment = stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        if (desc.depthFormat != GL_NONE && desc.sampledDepth && desc.samples == 0) {
+            glGenTextures(1, &target.depth);
+            glBindTexture(GL_TEXTURE_2D, target.depth);
+            if (desc.depthFormat == GL_DEPTH24_STENCIL8)
+                glTexImage2D(GL_TEXTURE_2D, 0, desc.depthFormat, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+            else if (desc.depthFormat == GL_DEPTH32F_STENCIL8)
+                glTexImage2D(GL_TEXTURE_2D, 0, desc.depthFormat, width, height, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, NULL);
+            else
+                glTexImage2D(GL_TEXTURE_2D, 0, desc.depthFormat, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment, GL_TEXTURE_2D, target.depth, 0);
+        }
+        else if (desc.depthFormat != GL_NONE) {
+            glGenRenderbuffers(1, &target.depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+            if (desc.samples > 0)
+                glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples, desc.depthFormat, width, height);
+            else
+                glRenderbufferStorage(GL_RENDERBUFFER, desc.depthFormat, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, depthAttachment, GL_RENDERBUFFER, target.depth);
+        }
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: " << width << "x" << height << " " << renderTargetFormatName(desc.colorFormat)
+                << " render target is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    static void destroy(RenderTarget& target) {
+        glDeleteFramebuffers(1, &target.fbo);
+        if (target.color)
+            glDeleteTextures(1, &target.color);
+        if (target.depth && target.desc.sampledDepth && target.desc.samples == 0)
+            glDeleteTextures(1, &target.depth);
+        else if (target.depth)
+            glDeleteRenderbuffers(1, &target.depth);
+        target.fbo = target.color = target.depth = 0;
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+#include "shader_s.h"
+
+#include <memory>
+#include <vector>
+#include <iostream>
+
+// Batch shader creation: add() issues the compiles and the link of every program right away
+// but never asks for their status, so the driver can overlap the work (on its own threads when
+// GL_KHR_parallel_shader_compile is available). Status is collected later by poll()/finish(),
+// or by Shader::use() when a program is needed before that.
+//
+//     ShaderCompileQueue queue;
+//     Shader& a = queue.add("a.vs", "a.fs");
+//     Shader& b = queue.add("b.vs", "b.fs");
+//     ... load models, textures ...
+//     queue.finish();
+class ShaderCompileQueue {
+public:
+    ShaderCompileQueue() {
+        const GLExtensions& ext = glExtensions();
+        if (ext.parallelShaderCompile)
+            ext.MaxShaderCompilerThreads(0xFFFFFFFFu); // let the driver pick the number of threads
+    }
+
+    // the returned reference stays valid for the lifetime of the queue
+    Shader& add(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) {
+        shaders.emplace_back(new Shader(vertexPath, fragmentPath, geometryPath, ShaderLink::Deferred));
+        return *shaders.back();
+    }
+
+    Shader& add(const ShaderSources& sources) {
+        shaders.emplace_back(new Shader(sources, ShaderLink::Deferred));
+        return *shaders.back();
+    }
+
+    // finish the programs the driver reports as done, without blocking; returns how many are still pending
+    size_t poll() {
+        size_t pending = 0;
+        for (auto& shader : shaders) {
+            if (!shader->isLinkPending())
+                continue;
+            // without the extension there is no way to tell without blocking, so leave it for finish()
+            if (glExtensions().parallelShaderCompile && shader->linkCompleted())
+                shader->finishLink();
+            else
+                pending++;
+        }
+        return pending;
+    }
+
+    // wait for every program and report errors
+    void finish() {
+        for (auto& shader : shaders)
+            shader->finishLink();
+    }
+
+    size_t size() const {
+        return shaders.size();
+    }
+
+private:
+    std::vector<std::unique_ptr<Shader>> shaders;
+};
@@ -0,0 +1,183 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// name -> value, injected as "#define name value" right after #version.
+// std::map keeps them sorted, so equal define sets always produce the same source text.
+typedef std::map<std::string, std::string> ShaderDefines;
+
+// preprocessed code of every stage; an empty geometry string means "no geometry shader",
+// an empty fragment string is only allowed for transform feedback programs (rasterizer discarded)
+struct ShaderSources {
+    std::string vertex;
+    std::string fragment;
+    std::string geometry;
+    std::vector<std::string> feedbackVaryings; // captured interleaved by transform feedback, in this order
+};
+
+// Minimal GLSL preprocessor, run on the CPU before glShaderSource:
+//  - #include "file" is replaced by the file's text; the path is relative to the including file.
+//    Included files may carry their own #version line (it is dropped) and "#pragma once".
+//  - defines are inserted after the #version line.
+//  - #line directives keep compiler messages pointing at the right line; the second number is
+//    the index of the file in the order it was first read (0 = the top-level file).
+// Everything else (#ifdef, #if, ...) is left to the GLSL compiler.
+class ShaderPreprocessor {
+public:
+    static std::string process(const std::string& path, const ShaderDefines& defines = ShaderDefines()) {
+        ShaderPreprocessor pp;
+        std::string body;
+        pp.expand(path, 0, body);
+
+        std::string out = pp.version.empty() ? "#version 330 core\n" : pp.version + "\n";
+        for (const auto& define : defines)
+            out += "#define " + define.first + " " + define.second + "\n";
+        out += body;
+        return out;
+    }
+
+    static ShaderSources load(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+        const ShaderDefines& defines = ShaderDefines()) {
+        ShaderSources sources;
+        sources.vertex = process(vertexPath, defines);
+        sources.fragment = process(fragmentPath, defines);
+        if (geometryPath != nullptr)
+            sources.geometry = process(geometryPath, defines);
+        return sources;
+    }
+
+private:
+    std::string version;
+    std::vector<std::string> files;        // every file read so far, index = #line source number
+    std::vector<std::string> includeStack;  // to report cycles
+    std::vector<std::string> onceFiles;     // files that said #pragma once
+
+    static std::string readFile(const std::string& path, bool& ok) {
+        std::ifstream file;
+        // ensure ifstream objects can throw exceptions:
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            ok = true;
+            return stream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << " " << e.what() << std::endl;
+            ok = false;
+            return std::string();
+        }
+    }
+
+    static std::string directoryOf(const std::string& path) {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // "a/b/../c.glsl" -> "a/c.glsl", so the same file reached by two routes is recognised
+    static std::string normalize(const std::string& path) {
+        std::vector<std::string> parts;
+        std::string part;
+        std::stringstream stream(path);
+        while (std::getline(stream, part, '/')) {
+            if (part == ".." && !parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else if (part != "." && !part.empty())
+                parts.push_back(part);
+            else if (part.empty() && parts.empty())
+                parts.push_back(""); // absolute path
+        }
+        std::string out;
+        for (size_t i = 0; i < parts.size(); i++)
+            out += (i ? "/" : "") + parts[i];
+        if (path.compare(0, 2, "./") == 0)
+            out = "./" + out;
+        return out;
+    }
+
+    static bool startsWithDirective(const std::string& line, const char* directive, size_t& rest) {
+        size_t i = line.find_first_not_of(" \t");
+        if (i == std::string::npos || line[i] != '#')
+            return false;
+        i = line.find_first_not_of(" \t", i + 1);
+        size_t n = std::char_traits<char>::length(directive);
+        if (i == std::string::npos || line.compare(i, n, directive) != 0)
+            return false;
+        rest = i + n;
+        return true;
+    }
+
+    void expand(const std::string& rawPath, int depth, std::string& out) {
+        std::string path = normalize(rawPath);
+        for (const auto& once : onceFiles)
+            if (once == path)
+                return;
+        for (const auto& open : includeStack) {
+            if (open == path) {
+                std::cout << "ERROR::SHADER::RECURSIVE_INCLUDE: " << path << std::endl;
+                return;
+            }
+        }
+
+        bool ok = false;
+        std::string text = readFile(path, ok);
+        if (!ok)
+            return;
+
+        int fileIndex = (int)files.size();
+        files.push_back(path);
+        includeStack.push_back(path);
+
+        std::stringstream stream(text);
+        std::string line;
+        int lineNumber = 0;
+        bool needLine = true;
+        while (std::getline(stream, line)) {
+            lineNumber++;
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            size_t rest = 0;
+            if (startsWithDirective(line, "version", rest)) {
+                if (depth == 0)
+                    version = line;
+                needLine = true;
+                continue;
+            }
+            if (startsWithDirective(line, "pragma", rest) && line.find("once", rest) != std::string::npos) {
+                onceFiles.push_back(path);
+                needLine = true;
+                continue;
+            }
+            if (startsWithDirective(line, "include", rest)) {
+                size_t open = line.find('"', rest);
+                size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+                if (close == std::string::npos) {
+                    std::cout << "ERROR::SHADER::BAD_INCLUDE: " << path << ":" << lineNumber << ": " << line << std::endl;
+                }
+                else {
+                    expand(directoryOf(path) + line.substr(open + 1, close - open - 1), depth + 1, out);
+                }
+                needLine = true;
+                continue;
+            }
+
+            if (needLine) {
+                out += "#line " + std::to_string(lineNumber) + " " + std::to_string(fileIndex) + "\n";
+                needLine = false;
+            }
+            out += line;
+            out += '\n';
+        }
+
+        includeStack.pop_back();
+    }
+};
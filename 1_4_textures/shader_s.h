@@ -6,163 +6,402 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "shader_cache.h"
+#include "shader_preprocessor.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstdint>
+
+// Uniform name hashed with FNV-1a. Constructing it from a string literal is constexpr, so a
+// constant like `constexpr UniformID projection("projection");` costs nothing at run time,
+// and passing a literal straight to Shader::set* neither allocates nor queries the driver.
+// Shader::location() finds it with a probe of a small hash table built after linking; 'check'
+// (a second, unrelated hash) and the length tell names apart whose FNV hashes collide.
+struct UniformID {
+    uint32_t hash;
+    uint32_t check;
+    uint32_t length;
+
+    constexpr UniformID(const char* name) : hash(hashName(name)), check(checkName(name)), length(nameLength(name)) {}
+    UniformID(const std::string& name) : UniformID(name.c_str()) {}
+
+    constexpr bool operator==(const UniformID& other) const {
+        return hash == other.hash && check == other.check && length == other.length;
+    }
+
+    static constexpr uint32_t hashName(const char* name) {
+        uint32_t h = 2166136261u;
+        while (*name != '\0') {
+            h = (h ^ static_cast<unsigned char>(*name++)) * 16777619u;
+        }
+        return h;
+    }
+
+    // djb2 (xor variant)
+    static constexpr uint32_t checkName(const char* name) {
+        uint32_t h = 5381u;
+        while (*name != '\0') {
+            h = (h * 33u) ^ static_cast<unsigned char>(*name++);
+        }
+        return h;
+    }
+
+    static constexpr uint32_t nameLength(const char* name) {
+        uint32_t length = 0;
+        while (name[length] != '\0')
+            length++;
+        return length;
+    }
+};
+
+// one active uniform; offset/strides are only meaningful for uniform block members (blockIndex >= 0)
+struct UniformInfo {
+    std::string name;
+    GLenum type = 0;
+    int size = 0;           // array length, 1 otherwise
+    int location = -1;      // -1 for block members
+    int blockIndex = -1;
+    int offset = -1;        // byte offset inside the block
+    int arrayStride = -1;
+    int matrixStride = -1;
+};
+
+struct UniformBlockInfo {
+    std::string name;
+    unsigned int index = 0;
+    unsigned int binding = 0;
+    int dataSize = 0;                   // size the buffer range bound to it must have
+    std::vector<unsigned int> members;  // indices into Shader::activeUniforms()
+};
+
+// Binding point per uniform block name, shared by every program: the first block called
+// "Matrices" gets binding 0, the next new name 1, and so on. Buffers are bound once to
+// UniformBlockBindings::get(name) and all programs declaring that block see them.
+class UniformBlockBindings {
+public:
+    static unsigned int get(const std::string& blockName) {
+        std::vector<std::string>& names = registry();
+        for (unsigned int i = 0; i < names.size(); i++)
+            if (names[i] == blockName)
+                return i;
+
+        int maxBindings = 0;
+        glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &maxBindings);
+        if ((int)names.size() >= maxBindings)
+            std::cout << "ERROR::SHADER::OUT_OF_UNIFORM_BUFFER_BINDINGS: " << blockName << std::endl;
+        names.push_back(blockName);
+        return (unsigned int)names.size() - 1;
+    }
+
+private:
+    static std::vector<std::string>& registry() {
+        static std::vector<std::string> names;
+        return names;
+    }
+};
+
+// Immediate: the constructor waits for the link result (classic behaviour).
+// Deferred: the constructor only issues compile + link; status is checked by finishLink(),
+// which use() calls on first use. See ShaderCompileQueue for batching.
+enum class ShaderLink {
+    Immediate,
+    Deferred
+};
 
 class Shader {
 public:
 	unsigned int ID;
 
-	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) {
-
-		// 1. retrieve the vertex/fragment source code from filePath
-		std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-		std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-
-        // ensure ifstream objects can throw exceptions:
-        // File > Stream > String (code)
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-
-            if (geometryPath != nullptr) {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-        }
+	// 1. retrieve the vertex/fragment source code from filePath (#include and defines are resolved by ShaderPreprocessor)
+	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, ShaderLink link = ShaderLink::Immediate)
+        : Shader(ShaderPreprocessor::load(vertexPath, fragmentPath, geometryPath), link) {
+	}
 
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-
-        // 2. compile shader
-        unsigned int vertex, fragment;
-
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-
-        unsigned int geometry;
-        if (geometryPath != nullptr) {
-            const char* gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
+	explicit Shader(const ShaderSources& sources, ShaderLink link = ShaderLink::Immediate) {
+        const std::string& vertexCode = sources.vertex;
+        const std::string& fragmentCode = sources.fragment;
+        const std::string& geometryCode = sources.geometry;
 
-        // program
+        // 2. reuse the cached program binary when the driver accepts it, otherwise compile and link
+        cacheKey = ProgramBinaryCache::key(vertexCode, fragmentCode, geometryCode, sources.feedbackVaryings);
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
-        {
-            glAttachShader(ID, geometry);
+        if (ProgramBinaryCache::load(ID, cacheKey)) {
+            reflect();
+            return;
         }
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
 
-        // delete
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if (geometryPath != nullptr) {
-            glDeleteShader(geometry);
-        }
+        issueCompileAndLink(vertexCode, fragmentCode, !geometryCode.empty() ? &geometryCode : nullptr, sources.feedbackVaryings);
+        if (link == ShaderLink::Immediate)
+            finishLink();
 	}
 
     void use() {
+        if (linkPending)
+            finishLink();
         glUseProgram(ID);
     }
 
-    void setBool(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    // true once finishLink() would not block. Without GL_KHR_parallel_shader_compile the driver
+    // can't be asked without waiting, so this reports true and finishLink() may stall.
+    bool linkCompleted() const {
+        if (!linkPending || !glExtensions().parallelShaderCompile)
+            return true;
+        int done = 0;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done != 0;
+    }
+
+    // check compile/link status (waits for the driver if needed), report errors,
+    // store the binary in the cache and reflect the uniforms
+    void finishLink() {
+        if (!linkPending)
+            return;
+        linkPending = false;
+
+        bool success = true;
+        for (unsigned int i = 0; i < stageCount; i++)
+            success = checkCompileErrors(stages[i], stageNames[i]) && success;
+        success = checkCompileErrors(ID, "PROGRAM") && success;
+
+        // delete
+        for (unsigned int i = 0; i < stageCount; i++) {
+            glDetachShader(ID, stages[i]);
+            glDeleteShader(stages[i]);
+        }
+        stageCount = 0;
+
+        if (success)
+            ProgramBinaryCache::store(ID, cacheKey);
+        reflect();
+    }
+
+    bool isLinkPending() const {
+        return linkPending;
     }
 
-    void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    void setBool(UniformID name, bool value) const {
+        glUniform1i(location(name), (int)value);
     }
 
-    void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    void setInt(UniformID name, int value) const {
+        glUniform1i(location(name), value);
     }
 
-    void setMatrix4(const std::string& name, glm::mat4 mat) const {
+    void setFloat(UniformID name, float value) const {
+        glUniform1f(location(name), value);
+    }
+
+    void setMatrix4(UniformID name, const glm::mat4& mat) const {
         // uniformλֵĿǷתãĬ󣩣ָ루Ҫglm::value_ptrתʽ
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()),1,GL_FALSE, glm::value_ptr(mat));
+        glUniformMatrix4fv(location(name),1,GL_FALSE, glm::value_ptr(mat));
     }
 
-    void setMatrix3(const std::string& name, glm::mat3 mat) const {
+    void setMatrix3(UniformID name, const glm::mat3& mat) const {
         // uniformλֵĿǷתãĬ󣩣ָ루Ҫglm::value_ptrתʽ
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, glm::value_ptr(mat));
     }
 
-    void setMatrix2(const std::string& name, glm::mat2 mat) const {
+    void setMatrix2(UniformID name, const glm::mat2& mat) const {
         // uniformλֵĿǷתãĬ󣩣ָ루Ҫglm::value_ptrתʽ
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, glm::value_ptr(mat));
     }
 
-    void setVec2(const std::string& name, const glm::vec2& value) const {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec2(UniformID name, const glm::vec2& value) const {
+        glUniform2fv(location(name), 1, &value[0]);
     }
 
-    void setVec2(const std::string& name, float v0, float v1) const {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), v0, v1);
+    void setVec2(UniformID name, float v0, float v1) const {
+        glUniform2f(location(name), v0, v1);
     }
 
-    void setVec3(const std::string& name, const glm::vec3& value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec3(UniformID name, const glm::vec3& value) const {
+        glUniform3fv(location(name), 1, &value[0]);
     }
 
-    void setVec3(const std::string& name, float v0, float v1, float v2) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), v0,v1,v2);
+    void setVec3(UniformID name, float v0, float v1, float v2) const {
+        glUniform3f(location(name), v0,v1,v2);
     }
 
-    void setVec4(const std::string& name, const glm::vec4& value) const {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec4(UniformID name, const glm::vec4& value) const {
+        glUniform4fv(location(name), 1, &value[0]);
     }
 
-    void setVec4(const std::string& name, float v0, float v1, float v2, float v3) const {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), v0, v1, v2, v3);
+    void setVec4(UniformID name, float v0, float v1, float v2, float v3) const {
+        glUniform4f(location(name), v0, v1, v2, v3);
     }
     
+    // location of an active uniform, or -1 (ignored by glUniform*) if the program doesn't have it
+    int location(UniformID name) const {
+        if (uniformTable.empty())
+            return -1;
+        for (unsigned int i = name.hash & uniformMask; ; i = (i + 1) & uniformMask) {
+            const UniformSlot& slot = uniformTable[i];
+            if (slot.location < 0 || slot.name == name)
+                return slot.location;
+        }
+    }
+
+    // active uniforms and uniform blocks as reported by the driver after linking
+    const std::vector<UniformInfo>& activeUniforms() const {
+        return uniforms;
+    }
+
+    const std::vector<UniformBlockInfo>& activeUniformBlocks() const {
+        return uniformBlocks;
+    }
+
+    const UniformBlockInfo* findUniformBlock(const std::string& name) const {
+        for (const auto& block : uniformBlocks)
+            if (block.name == name)
+                return &block;
+        return nullptr;
+    }
+
 private:
-    
+    std::vector<UniformInfo> uniforms;
+    std::vector<UniformBlockInfo> uniformBlocks;
+
+    // open-addressed table: name -> location, filled once after linking
+    struct UniformSlot {
+        UniformID name;
+        int location;
+    };
+    std::vector<UniformSlot> uniformTable;
+    unsigned int uniformMask = 0;
+
+    // enumerate the active uniforms and uniform blocks once after linking:
+    //  - plain uniforms go into the location table, so the set* functions never call glGetUniformLocation.
+    //    arrays are registered as "name", "name[0]" ... "name[size-1]"
+    //  - block members keep their std140 offset / strides
+    //  - every block is bound to the binding point UniformBlockBindings assigned to its name,
+    //    so programs sharing a block need no per-program setup
+    void reflect() {
+        int count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        uniforms.clear();
+        uniformBlocks.clear();
+        std::vector<std::pair<std::string, int>> entries;
+        std::vector<char> nameBuffer(maxLength + 1);
+        for (int i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+
+            UniformInfo info;
+            info.name.assign(nameBuffer.data(), length);
+            info.type = type;
+            info.size = size;
+            GLuint index = (GLuint)i;
+            glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_BLOCK_INDEX, &info.blockIndex);
+            glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_OFFSET, &info.offset);
+            glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &info.arrayStride);
+            glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &info.matrixStride);
+            info.location = info.blockIndex < 0 ? glGetUniformLocation(ID, info.name.c_str()) : -1;
+            uniforms.push_back(info);
+
+            if (info.location < 0)
+                continue; // member of a uniform block (or a built-in)
+
+            const std::string& name = info.name;
+            entries.emplace_back(name, info.location);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                std::string base = name.substr(0, name.size() - 3);
+                entries.emplace_back(base, info.location);
+                for (int j = 1; j < size; j++) {
+                    std::string element = base + "[" + std::to_string(j) + "]";
+                    entries.emplace_back(element, glGetUniformLocation(ID, element.c_str()));
+                }
+            }
+        }
+
+        unsigned int capacity = 8;
+        while (capacity < entries.size() * 2)
+            capacity *= 2;
+        uniformTable.assign(capacity, UniformSlot{ UniformID(""), -1 });
+        uniformMask = capacity - 1;
+
+        for (const auto& entry : entries) {
+            UniformID name(entry.first);
+            unsigned int i = name.hash & uniformMask;
+            while (uniformTable[i].location >= 0 && !(uniformTable[i].name == name))
+                i = (i + 1) & uniformMask;
+            if (uniformTable[i].location >= 0 && uniformTable[i].location != entry.second)
+                std::cout << "WARNING::SHADER::UNIFORM_HASH_COLLISION: " << entry.first << std::endl;
+            uniformTable[i] = UniformSlot{ name, entry.second };
+        }
+
+        int blockCount = 0, maxBlockNameLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+        std::vector<char> blockNameBuffer(maxBlockNameLength + 1);
+        for (int i = 0; i < blockCount; i++) {
+            GLsizei length = 0;
+            glGetActiveUniformBlockName(ID, i, (GLsizei)blockNameBuffer.size(), &length, blockNameBuffer.data());
+
+            UniformBlockInfo block;
+            block.name.assign(blockNameBuffer.data(), length);
+            block.index = (unsigned int)i;
+            glGetActiveUniformBlockiv(ID, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+            for (unsigned int u = 0; u < uniforms.size(); u++)
+                if (uniforms[u].blockIndex == i)
+                    block.members.push_back(u);
+
+            block.binding = UniformBlockBindings::get(block.name);
+            glUniformBlockBinding(ID, block.index, block.binding);
+            uniformBlocks.push_back(block);
+        }
+    }
+
+    // stages kept alive until finishLink() so their info logs can still be read
+    unsigned int stages[3] = { 0, 0, 0 };
+    const char* stageNames[3] = { nullptr, nullptr, nullptr };
+    unsigned int stageCount = 0;
+    bool linkPending = false;
+    uint64_t cacheKey = 0;
+
+    // compile the stages and link them into ID without querying any status,
+    // so the driver is free to do the work in the background
+    void issueCompileAndLink(const std::string& vertexCode, const std::string& fragmentCode, const std::string* geometryCode,
+        const std::vector<std::string>& feedbackVaryings) {
+        addStage(GL_VERTEX_SHADER, "VERTEX", vertexCode);
+        if (!fragmentCode.empty())
+            addStage(GL_FRAGMENT_SHADER, "FRAGMENT", fragmentCode);
+        if (geometryCode != nullptr)
+            addStage(GL_GEOMETRY_SHADER, "GEOMETRY", *geometryCode);
+
+        // program
+        for (unsigned int i = 0; i < stageCount; i++)
+            glAttachShader(ID, stages[i]);
+        if (!feedbackVaryings.empty()) {
+            // which outputs transform feedback captures has to be known at link time
+            std::vector<const char*> names;
+            for (const std::string& varying : feedbackVaryings)
+                names.push_back(varying.c_str());
+            glTransformFeedbackVaryings(ID, (GLsizei)names.size(), names.data(), GL_INTERLEAVED_ATTRIBS);
+        }
+        ProgramBinaryCache::prepare(ID);
+        glLinkProgram(ID);
+        linkPending = true;
+    }
+
+    void addStage(GLenum type, const char* name, const std::string& code) {
+        const char* source = code.c_str();
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        stageNames[stageCount] = name;
+        stages[stageCount++] = shader;
+    }
+
     // utility function for checking shader compilation/linking errors.
-    void checkCompileErrors(unsigned int shader, std::string type) {
+    bool checkCompileErrors(unsigned int shader, std::string type) {
         int success;
         char infoLog[1024];
         if (type != "PROGRAM")
@@ -183,5 +422,6 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
\ No newline at end of file
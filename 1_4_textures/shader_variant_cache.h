@@ -0,0 +1,44 @@
+#pragma once
+#include "shader_s.h"
+#include "shader_preprocessor.h"
+#include "shader_compile_queue.h"
+
+#include <string>
+#include <unordered_map>
+
+// One Shader per (sources, define set) permutation, created the first time it is asked for.
+// Specialising with defines (e.g. INSTANCED) instead of branching on uniforms keeps the
+// shaders branch-free without keeping copies of the files, and only the variants that are
+// actually requested are ever compiled. Programs are owned by the ShaderCompileQueue, so
+// variants requested up front are compiled as one batch.
+class ShaderVariantCache {
+public:
+    explicit ShaderVariantCache(ShaderCompileQueue& queue) : queue(queue) {}
+
+    Shader& get(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines(),
+        const char* geometryPath = nullptr) {
+        std::string key = makeKey(vertexPath, fragmentPath, geometryPath, defines);
+        auto it = variants.find(key);
+        if (it != variants.end())
+            return *it->second;
+
+        Shader& shader = queue.add(ShaderPreprocessor::load(vertexPath, fragmentPath, geometryPath, defines));
+        variants.emplace(key, &shader);
+        return shader;
+    }
+
+    size_t size() const {
+        return variants.size();
+    }
+
+private:
+    ShaderCompileQueue& queue;
+    std::unordered_map<std::string, Shader*> variants;
+
+    static std::string makeKey(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const ShaderDefines& defines) {
+        std::string key = std::string(vertexPath) + "|" + fragmentPath + "|" + (geometryPath ? geometryPath : "");
+        for (const auto& define : defines)
+            key += "|" + define.first + "=" + define.second;
+        return key;
+    }
+};
@@ -6,17 +6,17 @@ in vec2 TexCoords;
 uniform sampler2D screenTexture;
 
 vec4 kernelProcess(){
-    const float offset = 1.0 / 300.0;
+    vec2 offset = 1.0 / vec2(textureSize(screenTexture, 0)); // 一个纹素：按纹理的实际大小，与分辨率无关
     vec2 offsets[9] = vec2[](
-        vec2(-offset,  offset), // 左上
-        vec2( 0.0f,    offset), // 正上
-        vec2( offset,  offset), // 右上
-        vec2(-offset,  0.0f),   // 左
-        vec2( 0.0f,    0.0f),   // 中
-        vec2( offset,  0.0f),   // 右
-        vec2(-offset, -offset), // 左下
-        vec2( 0.0f,   -offset), // 正下
-        vec2( offset, -offset)  // 右下
+        vec2(-offset.x,  offset.y), // 左上
+        vec2( 0.0f,      offset.y), // 正上
+        vec2( offset.x,  offset.y), // 右上
+        vec2(-offset.x,  0.0f),     // 左
+        vec2( 0.0f,      0.0f),     // 中
+        vec2( offset.x,  0.0f),     // 右
+        vec2(-offset.x, -offset.y), // 左下
+        vec2( 0.0f,     -offset.y), // 正下
+        vec2( offset.x, -offset.y)  // 右下
     );
 
     // float kernel[9] = float[]( // 锐化
@@ -0,0 +1,24 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// one direction of a separable Gaussian: taps[0] is the center, every other tap is a pair of
+// neighbouring texels read with one bilinear fetch (on both sides of the center)
+const int MAX_TAPS = 16;
+
+uniform sampler2D screenTexture;
+uniform vec2 direction;          // one source texel along the blur axis, in uv
+uniform int taps;
+uniform float offsets[MAX_TAPS]; // in texels
+uniform float weights[MAX_TAPS];
+
+void main()
+{
+    vec3 color = texture(screenTexture, TexCoords).rgb * weights[0];
+    for (int i = 1; i < taps; i++) {
+        vec2 offset = direction * offsets[i];
+        color += (texture(screenTexture, TexCoords + offset).rgb + texture(screenTexture, TexCoords - offset).rgb) * weights[i];
+    }
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform vec4 pointColor; // average colour of the impostor atlas
+
+void main()
+{
+    vec2 p = gl_PointCoord * 2.0 - 1.0;
+    if (dot(p, p) > 1.0)
+        discard;
+    FragColor = pointColor;
+}
@@ -0,0 +1,17 @@
+#version 330 core
+// Far tier of the impostors (impostor.h): one point per instance, as large as its bounding sphere
+// on screen (see gl_PointSize_test's pointShader.vs).
+#include "../include/model_matrix.glsl"
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec4 meshSphere; // bounding sphere of the mesh in model space: xyz = center, w = radius
+uniform float pixelScale; // pixels per unit at distance 1
+
+void main()
+{
+    mat4 model = modelMatrix();
+    float radius = meshSphere.w * length(model[0].xyz);
+    gl_Position = projection * view * model * vec4(meshSphere.xyz, 1.0);
+    gl_PointSize = max(1.0, 2.0 * radius * pixelScale / gl_Position.w);
+}
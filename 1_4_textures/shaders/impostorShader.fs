@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D atlas;
+
+void main()
+{
+    vec4 texel = texture(atlas, TexCoords);
+    if (texel.a < 0.5)
+        discard;
+    FragColor = vec4(texel.rgb / texel.a, 1.0); // the atlas is premultiplied (black background)
+}
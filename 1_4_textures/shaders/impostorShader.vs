@@ -0,0 +1,56 @@
+#version 330 core
+// Octahedral impostor (impostor.h): one quad per instance, textured with the atlas frame captured
+// from the direction nearest to the one the camera sees the instance from.
+layout (location = 0) in vec2 aCorner; // -1..1
+
+#include "../include/model_matrix.glsl"
+
+out vec2 TexCoords;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 eye;
+uniform vec4 meshSphere; // bounding sphere of the mesh in model space: xyz = center, w = radius
+uniform float frames;    // frames per side of the atlas
+
+// the same functions as OctahedralImpostor::octahedralEncode / octahedralDecode
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 octahedralEncode(vec3 d)
+{
+    vec3 n = d / (abs(d.x) + abs(d.y) + abs(d.z));
+    vec2 p = n.xz;
+    if (n.y < 0.0)
+        p = (1.0 - abs(p.yx)) * signNotZero(p);
+    return p;
+}
+
+vec3 octahedralDecode(vec2 p)
+{
+    vec3 d = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    if (d.y < 0.0)
+        d.xz = (1.0 - abs(p.yx)) * signNotZero(p);
+    return normalize(d);
+}
+
+void main()
+{
+    mat4 model = modelMatrix();
+    vec3 center = vec3(model * vec4(meshSphere.xyz, 1.0));
+    // view direction in model space (the matrix is a rotation with a uniform scale)
+    vec3 toEye = normalize(transpose(mat3(model)) * (eye - center));
+
+    vec2 cell = floor((octahedralEncode(toEye) * 0.5 + 0.5) * (frames - 1.0) + 0.5);
+    vec3 d = octahedralDecode(cell * (2.0 / (frames - 1.0)) - 1.0);
+    // the basis glm::lookAt used when the frame was baked
+    vec3 up = abs(d.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(-d, up));
+    up = cross(right, -d);
+
+    vec3 corner = meshSphere.xyz + (aCorner.x * right + aCorner.y * up) * meshSphere.w;
+    TexCoords = (cell + aCorner * 0.5 + 0.5) / frames;
+    gl_Position = projection * view * model * vec4(corner, 1.0);
+}
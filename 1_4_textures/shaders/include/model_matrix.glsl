@@ -0,0 +1,36 @@
+// model matrix of the vertex being drawn:
+// INSTANCED -> per-instance attribute (glVertexAttribDivisor = 1), otherwise the "model" uniform
+// INSTANCED + INSTANCE_QUAT -> compact instance: position, uniform scale and rotation quaternion
+//                              (InstanceFormat::Quat / PackedHalf in instance_format.h)
+// The instance attributes start at location 7 (InstanceAttributeLocation): 0-6 belong to the mesh.
+#pragma once
+
+#if defined(INSTANCED) && defined(INSTANCE_QUAT)
+layout (location = 7) in vec4 instancePositionScale; // xyz = position, w = uniform scale
+layout (location = 8) in vec4 instanceRotation;      // quaternion xyzw
+
+mat4 modelMatrix()
+{
+    vec4 q = normalize(instanceRotation); // snorm16 input is only nearly unit length
+    float s = instancePositionScale.w;
+    // rotation matrix of q, column by column
+    vec3 c0 = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+    vec3 c1 = vec3(2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x));
+    vec3 c2 = vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+    return mat4(vec4(c0 * s, 0.0), vec4(c1 * s, 0.0), vec4(c2 * s, 0.0), vec4(instancePositionScale.xyz, 1.0));
+}
+#elif defined(INSTANCED)
+layout (location = 7) in mat4 instanceMatrix;
+
+mat4 modelMatrix()
+{
+    return instanceMatrix;
+}
+#else
+uniform mat4 model;
+
+mat4 modelMatrix()
+{
+    return model;
+}
+#endif
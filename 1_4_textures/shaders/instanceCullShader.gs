@@ -0,0 +1,31 @@
+#version 330 core
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in VS_OUT {
+    vec4 data[4];
+    float visible;
+} gs_in[];
+
+// captured by transform feedback, interleaved: 4 vec4s (mat4) or, with INSTANCE_QUAT, 2 vec4s
+out vec4 instanceData0;
+out vec4 instanceData1;
+#ifndef INSTANCE_QUAT
+out vec4 instanceData2;
+out vec4 instanceData3;
+#endif
+
+void main()
+{
+    if (gs_in[0].visible == 0.0)
+        return; // culled: nothing is emitted, so nothing is written
+
+    instanceData0 = gs_in[0].data[0];
+    instanceData1 = gs_in[0].data[1];
+#ifndef INSTANCE_QUAT
+    instanceData2 = gs_in[0].data[2];
+    instanceData3 = gs_in[0].data[3];
+#endif
+    EmitVertex();
+    EndPrimitive();
+}
@@ -0,0 +1,45 @@
+#version 330 core
+// GPU frustum culling (gpu_instance_culling.h): one point per instance, drawn with the rasterizer
+// discarded. The vertex shader tests the instance's bounding sphere against the six frustum planes,
+// the geometry shader passes only the visible instances on to transform feedback.
+#ifdef INSTANCE_QUAT
+layout (location = 0) in vec4 instancePositionScale; // xyz = position, w = uniform scale
+layout (location = 1) in vec4 instanceRotation;      // quaternion xyzw
+#else
+layout (location = 0) in mat4 instanceMatrix;
+#endif
+
+out VS_OUT {
+    vec4 data[4]; // the instance as it is written out: matrix columns, or position/scale + quaternion
+    float visible;
+} vs_out;
+
+uniform vec4 planes[6];  // xyz = normal pointing inside, w = distance
+uniform vec4 meshSphere; // bounding sphere of the mesh in model space: xyz = center, w = radius
+
+void main()
+{
+#ifdef INSTANCE_QUAT
+    vec4 q = normalize(instanceRotation);
+    // rotate the sphere center by q: v + 2 * cross(q.xyz, cross(q.xyz, v) + q.w * v)
+    vec3 v = meshSphere.xyz;
+    vec3 rotated = v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+    vec3 center = instancePositionScale.xyz + rotated * instancePositionScale.w;
+    float radius = meshSphere.w * instancePositionScale.w;
+    vs_out.data[0] = instancePositionScale;
+    vs_out.data[1] = q;
+    vs_out.data[2] = vec4(0.0);
+    vs_out.data[3] = vec4(0.0);
+#else
+    vec3 center = (instanceMatrix * vec4(meshSphere.xyz, 1.0)).xyz;
+    float scale = max(length(instanceMatrix[0].xyz), max(length(instanceMatrix[1].xyz), length(instanceMatrix[2].xyz)));
+    float radius = meshSphere.w * scale;
+    for (int i = 0; i < 4; i++)
+        vs_out.data[i] = instanceMatrix[i];
+#endif
+
+    vs_out.visible = 1.0;
+    for (int i = 0; i < 6; i++)
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius)
+            vs_out.visible = 0.0;
+}
@@ -1,15 +1,16 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 2) in vec2 aTexCoords;
+layout (location = 2) in vec2 aTexCoords; // 注意这里把aNormal跳过了
+
+#include "include/model_matrix.glsl" // 定义INSTANCED时model矩阵来自实例化数组（原instancedAsteroidBeltShader2.vs）
 
 out vec2 TexCoords;
 
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
 
 void main()
 {
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0f); 
+    gl_Position = projection * view * modelMatrix() * vec4(aPos, 1.0f); 
 }
\ No newline at end of file
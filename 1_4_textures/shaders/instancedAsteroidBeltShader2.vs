@@ -1,16 +0,0 @@
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 2) in vec2 aTexCoords; // 注意这里把aNormal跳过了
-layout (location = 3) in mat4 instanceMatrix;
-
-out vec2 TexCoords;
-
-uniform mat4 projection;
-uniform mat4 view;
-// uniform mat4 model;
-
-void main()
-{
-    TexCoords = aTexCoords;
-    gl_Position = projection * view * instanceMatrix * vec4(aPos, 1.0f); 
-}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// dual-Kawase downsample: the center and the four diagonal corners half a texel out, each
+// bilinear fetch averaging four source texels
+uniform sampler2D screenTexture;
+uniform vec2 halfPixel;   // half a source texel, in uv
+
+void main()
+{
+    vec3 sum = texture(screenTexture, TexCoords).rgb * 4.0;
+    sum += texture(screenTexture, TexCoords - halfPixel).rgb;
+    sum += texture(screenTexture, TexCoords + halfPixel).rgb;
+    sum += texture(screenTexture, TexCoords + vec2(halfPixel.x, -halfPixel.y)).rgb;
+    sum += texture(screenTexture, TexCoords - vec2(halfPixel.x, -halfPixel.y)).rgb;
+    FragColor = vec4(sum / 8.0, 1.0);
+}
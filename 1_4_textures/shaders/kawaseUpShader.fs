@@ -0,0 +1,21 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// dual-Kawase upsample: a tent of eight bilinear fetches around the pixel
+uniform sampler2D screenTexture;
+uniform vec2 halfPixel;   // half a source texel, in uv
+
+void main()
+{
+    vec3 sum = texture(screenTexture, TexCoords + vec2(-halfPixel.x * 2.0, 0.0)).rgb;
+    sum += texture(screenTexture, TexCoords + vec2(halfPixel.x * 2.0, 0.0)).rgb;
+    sum += texture(screenTexture, TexCoords + vec2(0.0, halfPixel.y * 2.0)).rgb;
+    sum += texture(screenTexture, TexCoords + vec2(0.0, -halfPixel.y * 2.0)).rgb;
+    sum += texture(screenTexture, TexCoords + vec2(-halfPixel.x, halfPixel.y)).rgb * 2.0;
+    sum += texture(screenTexture, TexCoords + vec2(halfPixel.x, halfPixel.y)).rgb * 2.0;
+    sum += texture(screenTexture, TexCoords + vec2(halfPixel.x, -halfPixel.y)).rgb * 2.0;
+    sum += texture(screenTexture, TexCoords + vec2(-halfPixel.x, -halfPixel.y)).rgb * 2.0;
+    FragColor = vec4(sum / 12.0, 1.0);
+}
@@ -0,0 +1,49 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// temporal anti-aliasing: blend this frame (rendered with a sub-pixel jitter) into the history of
+// earlier frames, reprojected with the depth of this frame and clamped to this frame's neighborhood
+uniform sampler2D currentTexture;   // this frame, jittered
+uniform sampler2D depthTexture;     // its depth
+uniform sampler2D historyTexture;   // the last output of this pass
+uniform mat4 reprojection;          // unjittered clip space of this frame -> of the previous frame
+uniform vec2 jitter;                // this frame's offset in NDC, taken off before reprojecting
+uniform vec2 texelSize;
+uniform float blend;                // weight of this frame; 1.0 without a history
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    // the box of colors around the pixel: a reprojected history color outside of it belongs to
+    // something that is not here any more (disocclusion, moving rocks) and is pulled into it
+    vec3 current = texture(currentTexture, TexCoords).rgb;
+    vec3 low = current, high = current;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++) {
+            vec3 color = texture(currentTexture, TexCoords + vec2(x, y) * texelSize).rgb;
+            low = min(low, color);
+            high = max(high, color);
+        }
+
+    float depth = texture(depthTexture, TexCoords).r;
+    // the scene was drawn shifted by 'jitter': move the pixel back to where the unjittered
+    // projection puts it, or the history is sampled a sub-pixel off and the image swims
+    vec4 previous = reprojection * vec4(TexCoords * 2.0 - 1.0 - jitter, depth * 2.0 - 1.0, 1.0);
+    vec2 historyUv = previous.xy / previous.w * 0.5 + 0.5;
+    if (blend >= 1.0 || any(lessThan(historyUv, vec2(0.0))) || any(greaterThan(historyUv, vec2(1.0)))) {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+    vec3 history = clamp(texture(historyTexture, historyUv).rgb, low, high);
+
+    // weights divided by 1 + luma: a single bright sample does not flicker through the history
+    float currentWeight = blend / (1.0 + luma(current));
+    float historyWeight = (1.0 - blend) / (1.0 + luma(history));
+    FragColor = vec4((current * currentWeight + history * historyWeight) / (currentWeight + historyWeight), 1.0);
+}
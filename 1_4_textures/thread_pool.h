@@ -0,0 +1,133 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for data-parallel loops that run every frame. The threads are
+// created once and sleep between jobs, so a parallelFor() costs a wake-up, not a thread launch.
+//
+//     ThreadPool pool;
+//     pool.parallelFor(count, 1024, [&](size_t begin, size_t end) { ... });
+//
+// The calling thread works on the job too and parallelFor() returns when every chunk is done.
+// Jobs are not reentrant: do not call parallelFor() from inside a job.
+class ThreadPool {
+public:
+    typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+    // 0 = one thread per hardware thread, counting the caller
+    explicit ThreadPool(unsigned int threadCount = 0) {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // threads that take part in a job, including the caller
+    unsigned int size() const {
+        return (unsigned int)workers.size() + 1;
+    }
+
+    // calls fn(begin, end) for consecutive ranges of at most 'grain' items covering [0, count)
+    void parallelFor(size_t count, size_t grain, const RangeFunction& fn) {
+        if (count == 0)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+        if (chunks == 1 || workers.empty()) {
+            fn(0, count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            jobCount = count;
+            jobGrain = grain;
+            nextChunk = 0;
+            pendingChunks = chunks;
+            generation++;
+        }
+        wake.notify_all();
+
+        runChunks(fn, count, grain, false);
+
+        // also wait for workers that picked up the job late and found nothing left, so none of
+        // them can still be holding 'fn' when the next job starts
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pendingChunks == 0 && activeWorkers == 0; });
+        job = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping = false;
+    unsigned long long generation = 0;
+
+    const RangeFunction* job = nullptr;
+    size_t jobCount = 0;
+    size_t jobGrain = 0;
+    std::atomic<size_t> nextChunk{ 0 };
+    size_t pendingChunks = 0;      // guarded by mutex
+    unsigned int activeWorkers = 0; // guarded by mutex
+
+    void runChunks(const RangeFunction& fn, size_t count, size_t grain, bool worker) {
+        size_t finished = 0;
+        for (;;) {
+            size_t chunk = nextChunk.fetch_add(1);
+            size_t begin = chunk * grain;
+            if (begin >= count)
+                break;
+            fn(begin, std::min(begin + grain, count));
+            finished++;
+        }
+        if (finished == 0 && !worker)
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingChunks -= finished;
+        if (worker)
+            activeWorkers--;
+        if (pendingChunks == 0 && activeWorkers == 0)
+            done.notify_all();
+    }
+
+    void workerLoop() {
+        unsigned long long seen = 0;
+        for (;;) {
+            const RangeFunction* fn;
+            size_t count, grain;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || (generation != seen && job != nullptr); });
+                if (stopping)
+                    return;
+                seen = generation;
+                activeWorkers++;
+                fn = job;
+                count = jobCount;
+                grain = jobGrain;
+            }
+            runChunks(*fn, count, grain, true);
+        }
+    }
+};
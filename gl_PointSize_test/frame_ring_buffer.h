@@ -0,0 +1,217 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <iostream>
+
+// a piece of the ring handed out for this frame; write 'size' bytes to 'data' before the next
+// allocate() (on the GL 3.3 path growing the ring moves the CPU copy 'data' points into).
+// data is nullptr and size 0 when the persistent ring is out of space.
+struct RingAllocation {
+    void* data = nullptr;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+};
+
+// Linear per-frame allocator on top of one GL buffer, for data that is rewritten every frame
+// (per-frame / per-pass / per-draw uniform blocks, streamed vertex or instance data).
+//
+//  - GL 4.4 / ARB_buffer_storage: the buffer holds 'frames' regions and stays persistently and
+//    coherently mapped. beginFrame() moves to the next region and waits on the fence placed by
+//    endFrame() when that region was last used, so the CPU never overwrites data the GPU may
+//    still be reading and never stalls on a busy buffer otherwise.
+//  - GL 3.3: beginFrame() orphans the buffer (glBufferData with NULL) so the driver hands out
+//    fresh storage, allocations are written to a CPU copy and commit() copies everything
+//    written since the last commit with one unsynchronized glMapBufferRange. A frame that needs
+//    more than bytesPerFrame grows the buffer (and the copy) instead of wrapping around.
+//
+// The persistent storage can't grow (it is immutable, and its name may already be attached to
+// vertex arrays), so size it for the largest frame: an allocation that doesn't fit prints an
+// error and comes back empty instead of overwriting data this frame already handed out.
+//
+// bind() commits before glBindBufferRange, so   alloc = ring.push(block); ring.bind(alloc, binding);
+// followed by the draw works on both paths. Anything else that reads the buffer (vertex
+// attributes pointing into it, ...) must call commit() before drawing.
+class FrameRingBuffer {
+public:
+    FrameRingBuffer(GLenum target, GLsizeiptr bytesPerFrame, unsigned int frames = 3)
+        : target(target), capacity(bytesPerFrame), frames(frames), fences(frames, nullptr) {
+        persistent = glExtensions().bufferStorage;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glExtensions().BufferStorage(target, capacity * frames, NULL, flags);
+            mapped = static_cast<char*>(glMapBufferRange(target, 0, capacity * frames, flags));
+            if (mapped == nullptr) {
+                std::cout << "ERROR::RING_BUFFER::PERSISTENT_MAP_FAILED, falling back to orphaning" << std::endl;
+                persistent = false;
+                glDeleteBuffers(1, &buffer);
+                glGenBuffers(1, &buffer);
+                glBindBuffer(target, buffer);
+            }
+        }
+        if (!persistent) {
+            glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+            shadow.resize(capacity);
+        }
+        glBindBuffer(target, 0);
+    }
+
+    ~FrameRingBuffer() {
+        for (GLsync fence : fences)
+            if (fence)
+                glDeleteSync(fence);
+        if (persistent) {
+            glBindBuffer(target, buffer);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+    }
+
+    FrameRingBuffer(const FrameRingBuffer&) = delete;
+    FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+
+    void beginFrame() {
+        cursor = 0;
+        committed = 0;
+        overflowed = false;
+        if (persistent) {
+            frame = (frame + 1) % frames;
+            waitForFence(fences[frame]);
+            fences[frame] = nullptr;
+        }
+        else {
+            glBindBuffer(target, buffer);
+            glBufferData(target, capacity, NULL, GL_STREAM_DRAW); // orphan
+            glBindBuffer(target, 0);
+        }
+    }
+
+    // call after the last draw that reads this frame's data
+    void endFrame() {
+        commit();
+        if (persistent)
+            fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    RingAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16) {
+        GLsizeiptr start = (cursor + alignment - 1) / alignment * alignment;
+        RingAllocation a;
+        if (start + size > capacity && persistent) {
+            if (!overflowed)
+                std::cout << "ERROR::RING_BUFFER::OUT_OF_SPACE: " << start + size << " > " << capacity << " bytes per frame" << std::endl;
+            overflowed = true;
+            return a;
+        }
+        if (start + size > capacity)
+            grow(start + size);
+        cursor = start + size;
+
+        a.offset = regionOffset() + start;
+        a.size = size;
+        a.data = persistent ? mapped + a.offset : shadow.data() + start;
+        return a;
+    }
+
+    // uniform blocks: offsets must be multiples of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    template<typename T>
+    RingAllocation push(const T& value) {
+        RingAllocation a = allocate(sizeof(T), target == GL_UNIFORM_BUFFER ? uniformAlignment() : 16);
+        if (a.data != nullptr)
+            std::memcpy(a.data, &value, sizeof(T));
+        return a;
+    }
+
+    // make everything allocated so far visible to the GPU (no-op for the persistent path)
+    void commit() {
+        if (persistent || committed >= cursor)
+            return;
+        glBindBuffer(target, buffer);
+        void* dst = glMapBufferRange(target, committed, cursor - committed,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (dst != nullptr) {
+            std::memcpy(dst, shadow.data() + committed, cursor - committed);
+            glUnmapBuffer(target);
+        }
+        glBindBuffer(target, 0);
+        committed = cursor;
+    }
+
+    void bind(const RingAllocation& allocation, GLuint bindingIndex) {
+        commit();
+        if (allocation.size > 0)
+            glBindBufferRange(target, bindingIndex, buffer, allocation.offset, allocation.size);
+    }
+
+    unsigned int id() const {
+        return buffer;
+    }
+
+    bool isPersistent() const {
+        return persistent;
+    }
+
+    // frames in which beginFrame() had to wait for the GPU (ring too short for the frame latency)
+    unsigned int stallCount() const {
+        return stalls;
+    }
+
+    static GLsizeiptr uniformAlignment() {
+        static GLint alignment = 0;
+        if (alignment == 0)
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return alignment;
+    }
+
+private:
+    GLenum target;
+    GLsizeiptr capacity;   // bytes per frame
+    unsigned int frames;
+    unsigned int buffer = 0;
+    bool persistent = false;
+    char* mapped = nullptr;
+    std::vector<char> shadow;
+    std::vector<GLsync> fences;
+    unsigned int frame = 0;
+    GLsizeiptr cursor = 0;
+    GLsizeiptr committed = 0;
+    bool overflowed = false;
+    unsigned int stalls = 0;
+
+    // orphan path: the frame needs more than 'capacity'. Draws issued so far keep reading the old
+    // storage (orphaning keeps it alive for them); the new, larger one gets all of this frame's
+    // data on the next commit(), so nothing is overwritten and the buffer name stays the same
+    void grow(GLsizeiptr needed) {
+        GLsizeiptr grown = std::max(capacity * 2, needed);
+        std::cout << "Ring buffer: " << needed << " > " << capacity << " bytes per frame, growing to " << grown << std::endl;
+        capacity = grown;
+        shadow.resize(capacity);
+        glBindBuffer(target, buffer);
+        glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+        glBindBuffer(target, 0);
+        committed = 0;
+    }
+
+    GLintptr regionOffset() const {
+        return persistent ? (GLintptr)frame * capacity : 0;
+    }
+
+    void waitForFence(GLsync fence) {
+        if (fence == nullptr)
+            return;
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            stalls++;
+            do {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+    }
+};
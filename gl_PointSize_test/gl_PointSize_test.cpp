@@ -3,6 +3,7 @@
 #include <GLFW/glfw3.h>
 
 #include "shader_s.h"
+#include "uniform_block.h"
 #include "camera.h"
 
 #include <glm/glm.hpp>
@@ -12,13 +13,13 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <chrono>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 
-
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -33,6 +34,32 @@ bool firstMouse = true;
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 
+// uniformBufferTestShader.vs 中的 layout (std140) uniform Matrices
+struct MatricesBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+
+    static const char* blockName() { return "Matrices"; }
+    static std::vector<Std140Member> layout() {
+        return { STD140_MEMBER(MatricesBlock, projection), STD140_MEMBER(MatricesBlock, view) };
+    }
+};
+
+// uniformBufferRingShader 中的 layout (std140) uniform PerDraw
+struct PerDrawBlock {
+    glm::mat4 model;
+    glm::vec4 color;
+
+    static const char* blockName() { return "PerDraw"; }
+    static std::vector<Std140Member> layout() {
+        return { STD140_MEMBER(PerDrawBlock, model), STD140_MEMBER(PerDrawBlock, color) };
+    }
+};
+
+// 按B键：比较 每个draw一次glBufferSubData（原来的做法） 与 FrameRingBuffer子分配 的上传开销
+bool runBenchmark = false;
+void runUniformUploadBenchmark(GLFWwindow* window, Shader& shader, unsigned int cubeVAO, UniformBlock<MatricesBlock>& matrices, FrameRingBuffer& uniformRing);
+
 int main()
 {
     // glfw: initialize and configure
@@ -89,33 +116,20 @@ int main()
     Shader uniformBufferTestShaderGreen("./shaders/uniformBufferTestShader.vs", "./shaders/uniformBufferTestShaderGreen.fs"); 
     Shader uniformBufferTestShaderBlue("./shaders/uniformBufferTestShader.vs", "./shaders/uniformBufferTestShaderBlue.fs"); 
     Shader uniformBufferTestShaderYellow("./shaders/uniformBufferTestShader.vs", "./shaders/uniformBufferTestShaderYellow.fs"); 
+    Shader uniformBufferRingShader("./shaders/uniformBufferRingShader.vs", "./shaders/uniformBufferRingShader.fs");
 
-    // （使用Uniform缓冲） 1. Uniform块设置为绑定点0
-    unsigned int uniformBlockIndexRed = glGetUniformBlockIndex(uniformBufferTestShaderRed.ID, "Matrices");
-    unsigned int uniformBlockIndexGreen = glGetUniformBlockIndex(uniformBufferTestShaderGreen.ID, "Matrices");
-    unsigned int uniformBlockIndexBlue = glGetUniformBlockIndex(uniformBufferTestShaderBlue.ID, "Matrices");
-    unsigned int uniformBlockIndexYellow = glGetUniformBlockIndex(uniformBufferTestShaderYellow.ID, "Matrices");
-
-    glUniformBlockBinding(uniformBufferTestShaderRed.ID, uniformBlockIndexRed, 0);
-    glUniformBlockBinding(uniformBufferTestShaderGreen.ID, uniformBlockIndexGreen, 0);
-    glUniformBlockBinding(uniformBufferTestShaderBlue.ID, uniformBlockIndexBlue, 0);
-    glUniformBlockBinding(uniformBufferTestShaderYellow.ID, uniformBlockIndexYellow, 0);
-
-    // （使用Uniform缓冲） 2. 创建Uniform Buffer，并将其局部内存（此处是全部）设置为与 绑定点0 绑定
-    unsigned int uboMatrices;
-    glGenBuffers(1, &uboMatrices);
+    // （使用Uniform缓冲） 1. Uniform块的绑定点由Shader在链接后反射时自动分配（UniformBlockBindings），不必逐个program设置
+    //                    2. UniformBlock<MatricesBlock> 创建Uniform Buffer并绑定到同一个绑定点；布局与着色器反射结果核对一次
+    UniformBlock<MatricesBlock> matrices;
+    matrices.validate(uniformBufferTestShaderRed);
 
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    // （使用Uniform缓冲） 3. 固定perspective矩阵的camera.zoom（view的更新在渲染循环中，见后，每帧整块上传一次）
+    matrices->projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 
-    glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4));
-
-    // （使用Uniform缓冲） 3. 固定perspective矩阵的camera.zoom，将数据输入Uniform Buffer中（view的更新在渲染循环中，见后）
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    // （使用Uniform缓冲） 4. 每帧变化的uniform数据从环形缓冲中子分配（GL 4.4: 持久映射+fence；GL 3.3: orphaning）
+    FrameRingBuffer uniformRing(GL_UNIFORM_BUFFER, 1024 * 1024);
+    std::cout << "Uniform ring buffer: " << (uniformRing.isPersistent() ? "persistent mapped" : "orphaning")
+        << ", offset alignment " << FrameRingBuffer::uniformAlignment() << std::endl;
 
     // load models
 
@@ -217,11 +231,16 @@ int main()
 
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 
+        if (runBenchmark) {
+            runBenchmark = false;
+            runUniformUploadBenchmark(window, uniformBufferRingShader, cubeVAO, matrices, uniformRing);
+        }
+
         // （使用Uniform Buffer）此处在每次渲染循环处更改view的数据
+        uniformRing.beginFrame();
         glm::mat4 view = camera.GetViewMatrix();
-        glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        matrices->view = view;
+        matrices.upload(uniformRing);
 
         pointShader.setMatrix4("projection", projection);
         pointShader.setMatrix4("view", view);
@@ -293,7 +312,7 @@ int main()
         glBindVertexArray(cubeVAO);
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
-
+        uniformRing.endFrame();
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -324,6 +343,9 @@ void processInput(GLFWwindow* window)
 
     }
 
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
+        runBenchmark = true;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -376,4 +398,86 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
-}
\ No newline at end of file
+}
+
+// uniform upload benchmark: 1000 cubes per frame, each with its own PerDraw block
+//  A. one GL_STATIC_DRAW uniform buffer rewritten with glBufferSubData before every draw (the pattern used for uboMatrices before)
+//  B. FrameRingBuffer: every draw gets its own aligned sub-allocation, bound with glBindBufferRange
+// CPU time is the submission time of a frame; GPU time comes from GL_TIME_ELAPSED queries read a few frames later
+// ---------------------------------------------------------------------------------------------------------
+void runUniformUploadBenchmark(GLFWwindow* window, Shader& shader, unsigned int cubeVAO, UniformBlock<MatricesBlock>& matrices, FrameRingBuffer& uniformRing)
+{
+    const int frames = 300;
+    const int drawsPerFrame = 1000;
+    const int queryLatency = 4;
+
+    // GL_STATIC_DRAW like uboMatrices was created with, so A measures the old pattern as it was;
+    // B never touches this buffer
+    UniformBlock<PerDrawBlock> perDraw(GL_STATIC_DRAW);
+    perDraw.validate(shader);
+
+    unsigned int queries[queryLatency];
+    glGenQueries(queryLatency, queries);
+
+    const char* names[2] = { "GL_STATIC_DRAW buffer, glBufferSubData per draw", "FrameRingBuffer" };
+    for (int mode = 0; mode < 2; mode++)
+    {
+        double cpuMs = 0.0;
+        GLuint64 gpuNs = 0;
+        int gpuSamples = 0;
+
+        for (int frame = 0; frame < frames; frame++)
+        {
+            int q = frame % queryLatency;
+            if (frame >= queryLatency) {
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(queries[q], GL_QUERY_RESULT, &ns);
+                gpuNs += ns;
+                gpuSamples++;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            glBeginQuery(GL_TIME_ELAPSED, queries[q]);
+
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shader.use();
+            glBindVertexArray(cubeVAO);
+
+            uniformRing.beginFrame();
+            matrices->view = camera.GetViewMatrix();
+            if (mode == 0)
+                matrices.upload();
+            else
+                matrices.upload(uniformRing);
+
+            for (int i = 0; i < drawsPerFrame; i++)
+            {
+                float x = (float)(i % 40) - 20.0f;
+                float z = (float)(i / 40) - 40.0f;
+                perDraw->model = glm::translate(glm::mat4(1.0f), glm::vec3(x, -2.0f, z));
+                perDraw->model = glm::scale(perDraw->model, glm::vec3(0.5f));
+                perDraw->color = glm::vec4((i % 7) / 6.0f, (i % 11) / 10.0f, (float)frame / frames, 1.0f);
+
+                if (mode == 0)
+                    perDraw.upload();
+                else
+                    perDraw.upload(uniformRing);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+            uniformRing.endFrame();
+
+            glEndQuery(GL_TIME_ELAPSED);
+            cpuMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+
+        std::cout << "[uniform upload benchmark] " << names[mode] << ": CPU " << cpuMs / frames << " ms/frame, GPU "
+            << (gpuSamples ? gpuNs / 1e6 / gpuSamples : 0.0) << " ms/frame (" << drawsPerFrame << " draws, "
+            << uniformRing.stallCount() << " ring stalls so far)" << std::endl;
+    }
+
+    glDeleteQueries(queryLatency, queries);
+}
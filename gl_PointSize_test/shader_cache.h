@@ -0,0 +1,163 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// The key hashes the shader sources together with GL_VENDOR, GL_RENDERER and GL_VERSION,
+// so a driver update or a different GPU simply misses and the program is compiled again.
+// A binary the driver refuses (GL_LINK_STATUS false after glProgramBinary) is also a miss.
+class ProgramBinaryCache {
+public:
+    struct Stats {
+        unsigned int hits = 0;
+        unsigned int misses = 0;
+        unsigned int stores = 0;
+    };
+
+    static Stats& stats() {
+        static Stats s;
+        return s;
+    }
+
+    static bool enabled() {
+        return glExtensions().programBinary;
+    }
+
+    static uint64_t key(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode) {
+        uint64_t h = 14695981039346656037ull;
+        h = hash(h, vertexCode);
+        h = hash(h, fragmentCode);
+        h = hash(h, geometryCode);
+        h = hash(h, driverString());
+        return h;
+    }
+
+    // try to fill 'program' from the cache; returns true if it is linked and ready to use
+    static bool load(unsigned int program, uint64_t key) {
+        if (!enabled())
+            return false;
+
+        std::ifstream file(path(key), std::ios::binary);
+        Header header;
+        if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            header.magic != MAGIC || header.key != key || header.length == 0) {
+            stats().misses++;
+            return false;
+        }
+
+        std::vector<char> binary(header.length);
+        if (!file.read(binary.data(), header.length)) {
+            stats().misses++;
+            return false;
+        }
+
+        glExtensions().ProgramBinary(program, header.format, binary.data(), (GLsizei)header.length);
+        int success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            stats().misses++;
+            return false;
+        }
+        stats().hits++;
+        return true;
+    }
+
+    // call before glLinkProgram, so the driver keeps a retrievable binary
+    static void prepare(unsigned int program) {
+        if (enabled())
+            glExtensions().ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // write the binary of a successfully linked program
+    static void store(unsigned int program, uint64_t key) {
+        if (!enabled())
+            return;
+
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        Header header;
+        header.key = key;
+        std::vector<char> binary(length);
+        GLsizei written = 0;
+        glExtensions().GetProgramBinary(program, length, &written, &header.format, binary.data());
+        header.length = (uint32_t)written;
+
+        makeDirectory();
+        std::ofstream file(path(key), std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cout << "WARNING::SHADER_CACHE::CANNOT_WRITE: " << path(key) << std::endl;
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), written);
+        stats().stores++;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x42504C47; // "GLPB"
+
+    // written as it is, so every byte is a field: no uninitialized padding ends up in the file
+    struct Header {
+        uint32_t magic = MAGIC;
+        GLenum format = 0;
+        uint32_t length = 0;
+        uint32_t reserved = 0;  // pads 'key' to its 8-byte alignment
+        uint64_t key = 0;
+    };
+    static_assert(sizeof(Header) == 24, "ProgramBinaryCache::Header must not contain padding");
+
+    static const char* directory() {
+        return "./shader_cache";
+    }
+
+    static std::string path(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+        return directory() + std::string(name);
+    }
+
+    static void makeDirectory() {
+#ifdef _WIN32
+        _mkdir(directory());
+#else
+        mkdir(directory(), 0755);
+#endif
+    }
+
+    static const std::string& driverString() {
+        static const std::string s = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+        return s;
+    }
+
+    static std::string glString(GLenum name) {
+        const GLubyte* s = glGetString(name);
+        return s ? reinterpret_cast<const char*>(s) : "";
+    }
+
+    // FNV-1a, 64 bit; the length is mixed in so ("ab","c") and ("a","bc") differ
+    static uint64_t hash(uint64_t h, const std::string& s) {
+        for (unsigned char c : s)
+            h = (h ^ c) * 1099511628211ull;
+        uint64_t n = s.size();
+        for (int i = 0; i < 8; i++, n >>= 8)
+            h = (h ^ (n & 0xff)) * 1099511628211ull;
+        return h;
+    }
+};
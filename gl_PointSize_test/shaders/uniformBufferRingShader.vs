@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+// 每个draw一份的数据，由FrameRingBuffer子分配后glBindBufferRange绑定
+layout (std140) uniform PerDraw
+{
+    mat4 model;
+    vec4 color;
+};
+
+void main()
+{
+   gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "shader_s.h"
+#include "frame_ring_buffer.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// one member of a C++ struct that mirrors a std140 uniform block
+struct Std140Member {
+    const char* name;
+    size_t offset;
+    size_t size;
+};
+
+#define STD140_MEMBER(Block, member) Std140Member{ #member, offsetof(Block, member), sizeof(((Block*)0)->member) }
+
+// Typed access to a std140 uniform block through a C++ struct with the same layout:
+//
+//     struct MatricesBlock {                   // layout (std140) uniform Matrices
+//         glm::mat4 projection;                // {
+//         glm::mat4 view;                      //     mat4 projection;
+//                                              //     mat4 view;
+//         static const char* blockName() { return "Matrices"; }
+//         static std::vector<Std140Member> layout() {
+//             return { STD140_MEMBER(MatricesBlock, projection), STD140_MEMBER(MatricesBlock, view) };
+//         }
+//     };
+//
+//     UniformBlock<MatricesBlock> matrices;
+//     matrices->view = camera.GetViewMatrix();
+//     matrices.upload();                       // the whole block in one call, for every program
+//
+// std140 reminders for writing the struct: vec3 and vec4 are 16-byte aligned, so a vec3 must be
+// a glm::vec4 (or be followed by a float that fills its padding); every array element and every
+// matrix column is padded to 16 bytes. The struct is written by hand rather than generated from
+// the reflected layout (that would need a build step that runs the driver); instead validate()
+// compares it with the offsets the driver reports, so a mismatch shows up at startup instead of
+// as garbage on screen.
+template<typename T>
+class UniformBlock {
+public:
+    T data;
+
+    // the buffer is bound once to the block's binding point from UniformBlockBindings, which is
+    // where every Shader that declares the block already points it
+    explicit UniformBlock(GLenum usage = GL_DYNAMIC_DRAW) : data() {
+        binding = UniformBlockBindings::get(T::blockName());
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, usage);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    }
+
+    ~UniformBlock() {
+        glDeleteBuffers(1, &buffer);
+    }
+
+    UniformBlock(const UniformBlock&) = delete;
+    UniformBlock& operator=(const UniformBlock&) = delete;
+
+    T* operator->() {
+        return &data;
+    }
+
+    // rewrite the block's own buffer (and make sure it is the one bound to the binding point)
+    void upload() const {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    }
+
+    // per-frame data: copy the block into this frame's part of the ring and bind that range
+    // instead of rewriting the block's own buffer, which the GPU may still be reading
+    void upload(FrameRingBuffer& ring) const {
+        ring.bind(ring.push(data), binding);
+    }
+
+    unsigned int getBinding() const {
+        return binding;
+    }
+
+    // check T against the layout reflected from 'shader'; prints every mismatch
+    bool validate(const Shader& shader) const {
+        const UniformBlockInfo* block = shader.findUniformBlock(T::blockName());
+        if (block == nullptr)
+            return true; // block optimised out or not used by this program
+
+        bool ok = true;
+        if (block->dataSize > (int)sizeof(T)) {
+            std::cout << "ERROR::UNIFORM_BLOCK::SIZE_MISMATCH: " << block->name << " is " << block->dataSize
+                << " bytes in the shader, " << sizeof(T) << " in C++" << std::endl;
+            ok = false;
+        }
+
+        std::vector<Std140Member> layout = T::layout();
+        for (unsigned int index : block->members) {
+            const UniformInfo& uniform = shader.activeUniforms()[index];
+            std::string name = memberName(uniform.name);
+            const Std140Member* member = nullptr;
+            for (const auto& m : layout)
+                if (name == m.name)
+                    member = &m;
+
+            if (member == nullptr) {
+                std::cout << "ERROR::UNIFORM_BLOCK::MISSING_MEMBER: " << block->name << "." << name << std::endl;
+                ok = false;
+            }
+            else if ((int)member->offset != uniform.offset) {
+                std::cout << "ERROR::UNIFORM_BLOCK::OFFSET_MISMATCH: " << block->name << "." << name << " is at "
+                    << uniform.offset << " in the shader, " << member->offset << " in C++" << std::endl;
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+private:
+    unsigned int buffer = 0;
+    unsigned int binding = 0;
+
+    // "Block.member[0]" -> "member"
+    static std::string memberName(const std::string& uniformName) {
+        size_t dot = uniformName.find('.');
+        std::string name = dot == std::string::npos ? uniformName : uniformName.substr(dot + 1);
+        size_t bracket = name.find('[');
+        return bracket == std::string::npos ? name : name.substr(0, bracket);
+    }
+};